@@ -11,19 +11,30 @@
 //===----------------------------------------------------------------------===//
 
 #include "buffer/parallel_buffer_pool_manager.h"
+
+#include <algorithm>
+
 #include "buffer/buffer_pool_manager_instance.h"
 
 namespace bustub {
 
 ParallelBufferPoolManager::ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager) {
+                                                     LogManager *log_manager, bool huge_pages,
+                                                     const std::vector<int> &numa_nodes, size_t max_pool_size,
+                                                     ReplacerPolicy replacer_policy) {
   // Allocate and create individual BufferPoolManagerInstances
   num_instances_ = num_instances;
   pool_size_ = pool_size;
   start_index_ = 0;
   instances_.resize(num_instances);
   for (size_t i = 0; i < num_instances; i++) {
-    instances_[i] = std::make_shared<BufferPoolManagerInstance>(pool_size, num_instances, i, disk_manager, log_manager);
+    // 每个实例的页框放在各自的NUMA节点上
+    FrameArenaOptions arena_options;
+    arena_options.huge_pages_ = huge_pages;
+    arena_options.numa_node_ = numa_nodes.empty() ? -1 : numa_nodes[i % numa_nodes.size()];
+    arena_options.max_frame_count_ = max_pool_size;
+    instances_[i] = std::make_shared<BufferPoolManagerInstance>(pool_size, num_instances, i, disk_manager, log_manager,
+                                                                replacer_policy, LRUK_REPLACER_K, arena_options);
   }
 }
 
@@ -36,12 +47,143 @@ auto ParallelBufferPoolManager::GetPoolSize() -> size_t {
   return pool_size_ * num_instances_;
 }
 
+auto ParallelBufferPoolManager::ResizePool(size_t pool_size, std::chrono::milliseconds drain_timeout) -> bool {
+  std::lock_guard<std::mutex> lock(resize_mutex_);
+  size_t old_pool_size = pool_size_;
+  for (size_t i = 0; i < num_instances_; i++) {
+    if (!instances_[i]->ResizePool(pool_size, drain_timeout)) {
+      // 恢复已经调整过的实例；只有缩小会失败，恢复时是扩大，不会再失败
+      for (size_t j = 0; j < i; j++) {
+        instances_[j]->ResizePool(old_pool_size, drain_timeout);
+      }
+      return false;
+    }
+  }
+  pool_size_ = pool_size;
+  return true;
+}
+
+auto ParallelBufferPoolManager::DumpResidentPages(const std::string &path) -> bool {
+  bool ok = true;
+  for (size_t i = 0; i < num_instances_; i++) {
+    ok = instances_[i]->DumpResidentPages(path + "." + std::to_string(i)) && ok;
+  }
+  return ok;
+}
+
+void ParallelBufferPoolManager::StartWarmUpDumps(const std::string &path, std::chrono::milliseconds interval) {
+  for (size_t i = 0; i < num_instances_; i++) {
+    instances_[i]->StartWarmUpDumps(path + "." + std::to_string(i), interval);
+  }
+}
+
+auto ParallelBufferPoolManager::WarmUp(const std::string &path, bool wait) -> size_t {
+  // 各实例先在后台并行加载，需要等待时再逐个等它们结束
+  size_t count = 0;
+  for (size_t i = 0; i < num_instances_; i++) {
+    count += instances_[i]->WarmUp(path + "." + std::to_string(i), false);
+  }
+  if (wait) {
+    for (auto &instance : instances_) {
+      instance->WaitWarmUp();
+    }
+  }
+  return count;
+}
+
+auto ParallelBufferPoolManager::GetStats() -> BufferPoolStats {
+  BufferPoolStats stats;
+  for (auto &instance : instances_) {
+    stats += instance->GetStats();
+  }
+  return stats;
+}
+
+auto ParallelBufferPoolManager::GetInstanceStats() -> std::vector<BufferPoolStats> {
+  std::vector<BufferPoolStats> stats;
+  stats.reserve(num_instances_);
+  for (auto &instance : instances_) {
+    stats.push_back(instance->GetStats());
+  }
+  return stats;
+}
+
+void ParallelBufferPoolManager::ResetStats() {
+  for (auto &instance : instances_) {
+    instance->ResetStats();
+  }
+}
+
+auto ParallelBufferPoolManager::GetHottestPages(size_t count) -> std::vector<PageHeat> {
+  // 每个实例最热的count个页合在一起，再取前count个
+  std::vector<PageHeat> pages;
+  for (auto &instance : instances_) {
+    std::vector<PageHeat> instance_pages = instance->GetHottestPages(count);
+    pages.insert(pages.end(), instance_pages.begin(), instance_pages.end());
+  }
+  count = std::min(count, pages.size());
+  std::partial_sort(pages.begin(), pages.begin() + count, pages.end(),
+                    [](const PageHeat &a, const PageHeat &b) { return a.fetches_ > b.fetches_; });
+  pages.resize(count);
+  return pages;
+}
+
 auto ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) -> BufferPoolManager * {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
   //对其取余，就知道应该放在哪个实例里面了。get()获取shareptr内部的指针。
   return instances_[page_id % num_instances_].get();
 }
 
+void ParallelBufferPoolManager::PrefetchPage(page_id_t page_id) {
+  PagePrefetcher *prefetcher = PagePrefetcher::FromBufferPool(GetBufferPoolManager(page_id));
+  if (prefetcher != nullptr) {
+    prefetcher->PrefetchPage(page_id);
+  }
+}
+
+void ParallelBufferPoolManager::PrefetchScanPage(page_id_t page_id) {
+  PagePrefetcher *prefetcher = PagePrefetcher::FromBufferPool(GetBufferPoolManager(page_id));
+  if (prefetcher != nullptr) {
+    prefetcher->PrefetchScanPage(page_id);
+  }
+}
+
+void ParallelBufferPoolManager::PrefetchRange(page_id_t first_page_id, size_t count) {
+  // 每个实例只预取范围内属于自己的页，各实例的I/O线程并行读取
+  for (auto &instance : instances_) {
+    PagePrefetcher *prefetcher = PagePrefetcher::FromBufferPool(instance.get());
+    if (prefetcher != nullptr) {
+      prefetcher->PrefetchRange(first_page_id, count);
+    }
+  }
+}
+
+auto ParallelBufferPoolManager::TryOptimisticRead(page_id_t page_id, OptimisticRead *read) -> bool {
+  if (page_id < 0) {
+    return false;
+  }
+  return instances_[page_id % num_instances_]->TryOptimisticRead(page_id, read);
+}
+
+void ParallelBufferPoolManager::BeginPageWrite(Page *page) {
+  instances_[page->GetPageId() % num_instances_]->BeginPageWrite(page);
+}
+
+void ParallelBufferPoolManager::EndPageWrite(Page *page) {
+  instances_[page->GetPageId() % num_instances_]->EndPageWrite(page);
+}
+
+auto ParallelBufferPoolManager::PinSwizzled(Page *page, page_id_t page_id) -> bool {
+  if (page_id < 0) {
+    return false;
+  }
+  return instances_[page_id % num_instances_]->PinSwizzled(page, page_id);
+}
+
+void ParallelBufferPoolManager::UnpinSwizzled(Page *page, bool is_dirty) {
+  instances_[page->GetPageId() % num_instances_]->UnpinSwizzled(page, is_dirty);
+}
+
 auto ParallelBufferPoolManager::FetchPgImp(page_id_t page_id) -> Page * {
   // Fetch page for page_id from responsible BufferPoolManagerInstance
   BufferPoolManager *manager = GetBufferPoolManager(page_id);
@@ -61,37 +203,43 @@ auto ParallelBufferPoolManager::FlushPgImp(page_id_t page_id) -> bool {
 }
 
 auto ParallelBufferPoolManager::NewPgImp(page_id_t *page_id) -> Page * {
-  // create new page. We will request page allocation in a round robin manner from the underlying
-  // BufferPoolManagerInstances
-  // 1.   From a starting index of the BPMIs, call NewPageImpl until either 1) success and return 2) looped around to
-  // starting index and return nullptr
-  // 2.   Bump the starting index (mod number of instances) to start search at a different BPMI each time this function
-  // is called
-  //对于newpgimp有点不一样，要根据start_instance的位置来判断新的page要放在哪个instance下面
-  // Page *page;
-  // size_t index = start_index_;
-  // do {
-  //   page = instances_[index]->NewPage(page_id);
-  //   if (page != nullptr) {
-  //     break;
-  //   }
-  //   index = (index + 1) % num_instances_;
-  // } while (index != start_index_);
-  // start_index_ = (start_index_ + 1) % num_instances_;
-  // return page;
-  //对于newpgimp有点不一样，要根据start_instance的位置来判断新的page要放在哪个instance下面
-  Page *page;
-  auto index = start_index_;
-  //注意要判断在这个instance中会不会创建失败，如果创建失败就到下一个instance中去创建
-  for(int i=index;i<=2*index;i++){
-    page=instances_[i]->NewPage(page_id);
-    if(page==nullptr){
-      break;
+  // 1. 轮流选择起始实例，即使只有一个线程在分配，新页也均匀分布到各个实例
+  size_t start = start_index_.fetch_add(1, std::memory_order_relaxed) % num_instances_;
+  Page *page = instances_[start]->NewPage(page_id);
+  if (page != nullptr) {
+    return page;
+  }
+  // 2. 起始实例已满，从可用页框最多的实例中窃取
+  size_t victim = start;
+  size_t most_available = 0;
+  for (size_t i = 0; i < num_instances_; i++) {
+    if (i == start) {
+      continue;
+    }
+    size_t available = instances_[i]->GetAvailableFrameCount();
+    if (available > most_available) {
+      victim = i;
+      most_available = available;
+    }
+  }
+  if (victim != start) {
+    page = instances_[victim]->NewPage(page_id);
+    if (page != nullptr) {
+      return page;
+    }
+  }
+  // 3. 可用页框数只是估计值，最后把剩下的每个实例都尝试一次
+  for (size_t i = 1; i < num_instances_; i++) {
+    size_t index = (start + i) % num_instances_;
+    if (index == victim) {
+      continue;
+    }
+    page = instances_[index]->NewPage(page_id);
+    if (page != nullptr) {
+      return page;
     }
-    index = (index+1)%num_instances_;
   }
-  start_index_ = (start_index_+1)%num_instances_;
-  return page;
+  return nullptr;
 }
 
 auto ParallelBufferPoolManager::DeletePgImp(page_id_t page_id) -> bool {
@@ -12,16 +12,27 @@
 
 #pragma once
 
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <memory>
+#include <mutex>  // NOLINT
+#include <string>
 #include <vector>
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/optimistic_page_reader.h"
+#include "buffer/page_prefetcher.h"
+#include "buffer/page_swizzler.h"
 #include "recovery/log_manager.h"
 #include "storage/disk/disk_manager.h"
 #include "storage/page/page.h"
 
 namespace bustub {
 
-class ParallelBufferPoolManager : public BufferPoolManager {
+class ParallelBufferPoolManager : public BufferPoolManager,
+                                  public PagePrefetcher,
+                                  public OptimisticPageReader,
+                                  public PageSwizzler {
  public:
   /**
    * Creates a new ParallelBufferPoolManager.
@@ -29,9 +40,16 @@ class ParallelBufferPoolManager : public BufferPoolManager {
    * @param pool_size the pool size of each BufferPoolManagerInstance
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param huge_pages back the frames of every instance with huge pages
+   * @param numa_nodes NUMA nodes the instances are bound to round-robin, empty to leave placement to the kernel
+   * @param max_pool_size pool size each instance can grow to with ResizePool, 0 for pool_size
+   * @param replacer_policy replacement policy of every instance; CLOCK by default, whose Pin/Unpin take no latch,
+   * so a page hit only takes the page table shard latch
    */
   ParallelBufferPoolManager(size_t num_instances, size_t pool_size, DiskManager *disk_manager,
-                            LogManager *log_manager = nullptr);
+                            LogManager *log_manager = nullptr, bool huge_pages = false,
+                            const std::vector<int> &numa_nodes = {}, size_t max_pool_size = 0,
+                            ReplacerPolicy replacer_policy = ReplacerPolicy::CLOCK);
 
   /**
    * Destroys an existing ParallelBufferPoolManager.
@@ -41,6 +59,92 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   /** @return size of the buffer pool */
   auto GetPoolSize() -> size_t override;
 
+  /**
+   * Grow or shrink every instance to pool_size frames while the buffer pool is in use, see
+   * BufferPoolManagerInstance::ResizePool. The number of instances is fixed, since page ids are assigned to instances
+   * by page_id % num_instances.
+   * @param pool_size new pool size of each instance, at most the max_pool_size given at construction
+   * @param drain_timeout how long each instance waits for pinned pages when shrinking
+   * @return false if an instance could not be resized, all instances then keep their old size
+   */
+  auto ResizePool(size_t pool_size, std::chrono::milliseconds drain_timeout = std::chrono::milliseconds(1000)) -> bool;
+
+  /**
+   * Dump the resident pages of every instance, see BufferPoolManagerInstance::DumpResidentPages. Instance i writes
+   * to path.i.
+   * @return false if a file could not be written
+   */
+  auto DumpResidentPages(const std::string &path) -> bool;
+
+  /** Dump the resident pages of every instance periodically and on shutdown, see DumpResidentPages. */
+  void StartWarmUpDumps(const std::string &path, std::chrono::milliseconds interval = std::chrono::minutes(1));
+
+  /**
+   * Reload the pages dumped by DumpResidentPages into every instance, see BufferPoolManagerInstance::WarmUp. The
+   * instances load their pages in parallel.
+   * @return the number of pages scheduled for loading
+   */
+  auto WarmUp(const std::string &path, bool wait = false) -> size_t;
+
+  /** @return the statistics of all instances summed up */
+  auto GetStats() -> BufferPoolStats;
+
+  /** @return the statistics of each instance, by instance index */
+  auto GetInstanceStats() -> std::vector<BufferPoolStats>;
+
+  /** Reset the statistics of all instances. */
+  void ResetStats();
+
+  /**
+   * @param count maximum number of pages to return
+   * @return the resident pages with the most buffer hits across all instances, hottest first
+   */
+  auto GetHottestPages(size_t count) -> std::vector<PageHeat>;
+
+  /**
+   * Schedule an asynchronous read of page_id on the instance responsible for it.
+   * @param page_id id of page to be prefetched
+   */
+  void PrefetchPage(page_id_t page_id) override;
+
+  /**
+   * Schedule an asynchronous read of a page a sequential scan reads next on the instance responsible for it.
+   * @param page_id id of page to be prefetched
+   */
+  void PrefetchScanPage(page_id_t page_id) override;
+
+  /**
+   * Schedule asynchronous reads of pages [first_page_id, first_page_id + count), each instance reads its own pages.
+   * @param first_page_id id of the first page to be prefetched
+   * @param count number of pages
+   */
+  void PrefetchRange(page_id_t first_page_id, size_t count) override;
+
+  /**
+   * Start an optimistic read of page_id on the instance responsible for it.
+   * @param page_id id of the page to be read
+   * @param[out] read the read, to be validated after the page content was read
+   * @return false if the page is not resident or is being modified
+   */
+  auto TryOptimisticRead(page_id_t page_id, OptimisticRead *read) -> bool override;
+
+  /** Mark a pinned page as being modified on the instance responsible for it. */
+  void BeginPageWrite(Page *page) override;
+
+  /** Finish a modification started with BeginPageWrite. */
+  void EndPageWrite(Page *page) override;
+
+  /**
+   * Pin a page through a swizzled reference on the instance responsible for it.
+   * @param page a Page pointer once returned for page_id
+   * @param page_id id of the page the reference was swizzled for
+   * @return false if the page is no longer in that frame
+   */
+  auto PinSwizzled(Page *page, page_id_t page_id) -> bool override;
+
+  /** Unpin a page pinned with PinSwizzled. */
+  void UnpinSwizzled(Page *page, bool is_dirty) override;
+
  protected:
   /**
    * @param page_id id of page
@@ -71,7 +175,10 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   auto FlushPgImp(page_id_t page_id) -> bool override;
 
   /**
-   * Creates a new page in the buffer pool.
+   * Creates a new page in the buffer pool. Successive calls start at successive instances, so pages spread evenly
+   * over the instances even if they are all created by one thread. When the chosen instance is full the page is
+   * taken from the instance with the most available frames, and as a last resort every instance is tried once, so
+   * this only fails if all of them are full.
    * @param[out] page_id id of created page
    * @return nullptr if no new pages could be created, otherwise pointer to new page
    */
@@ -91,9 +198,12 @@ class ParallelBufferPoolManager : public BufferPoolManager {
 
  private:
   // 改用vector与智能指针存储实例，就可以使用默认析构函数
-  std::vector<std::shared_ptr<BufferPoolManager>> instances_;
+  std::vector<std::shared_ptr<BufferPoolManagerInstance>> instances_;
   size_t num_instances_;
-  size_t pool_size_;
-  size_t start_index_;
+  std::atomic<size_t> pool_size_;
+  /** Serializes ResizePool calls. */
+  std::mutex resize_mutex_;
+  /** Instance the next NewPage call starts at. */
+  std::atomic<size_t> start_index_;
 };
 }  // namespace bustub
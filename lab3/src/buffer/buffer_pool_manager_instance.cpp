@@ -12,53 +12,113 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <utility>
+
+#include "common/logger.h"
 #include "common/macros.h"
 
 namespace bustub {
 
+static_assert(FRAME_ALIGNMENT % DISK_IO_ALIGNMENT == 0, "aligned frames must be usable for O_DIRECT I/O");
+
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager,
-                                                     LogManager *log_manager)
-    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager) {}
+                                                     LogManager *log_manager, ReplacerPolicy replacer_policy,
+                                                     size_t replacer_k, const FrameArenaOptions &arena_options)
+    : BufferPoolManagerInstance(pool_size, 1, 0, disk_manager, log_manager, replacer_policy, replacer_k,
+                                arena_options) {}
 
 BufferPoolManagerInstance::BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                                                     DiskManager *disk_manager, LogManager *log_manager)
+                                                     DiskManager *disk_manager, LogManager *log_manager,
+                                                     ReplacerPolicy replacer_policy, size_t replacer_k,
+                                                     const FrameArenaOptions &arena_options)
     : pool_size_(pool_size),
+      max_pool_size_(std::max(pool_size, arena_options.max_frame_count_)),
       num_instances_(num_instances),
       instance_index_(instance_index),
       next_page_id_(instance_index),
+      frame_arena_(std::make_unique<FrameArena>(pool_size, arena_options)),
+      frame_io_(max_pool_size_, FrameIOState::IDLE),
+      frame_page_ids_(max_pool_size_),
+      frame_versions_(max_pool_size_),
+      location_hints_(2 * max_pool_size_),
+      swizzle_pins_(max_pool_size_),
+      frame_unlisted_(max_pool_size_, 0),
+      frame_fetches_(max_pool_size_, 0),
       disk_manager_(disk_manager),
+      disk_io_(std::make_unique<SyncDiskIO>(disk_manager)),
       log_manager_(log_manager) {
   BUSTUB_ASSERT(num_instances > 0, "If BPI is not part of a pool, then the pool size should just be 1");
   BUSTUB_ASSERT(
       instance_index < num_instances,
       "BPI index cannot be greater than the number of BPIs in the pool. In non-parallel case, index should just be 1.");
-  // We allocate a consecutive memory space for the buffer pool.
-  pages_ = new Page[pool_size_];
-  replacer_ = new LRUReplacer(pool_size);
+  // We allocate a consecutive memory space for the buffer pool (see frame_arena_).
+  // 按最大容量创建replacer，扩容时不需要重建
+  switch (replacer_policy) {
+    case ReplacerPolicy::CLOCK:
+      replacer_ = new ClockReplacer(max_pool_size_);
+      break;
+    case ReplacerPolicy::LRU_K:
+      replacer_ = new LRUKReplacer(max_pool_size_, replacer_k);
+      break;
+    case ReplacerPolicy::PARTITIONED_LRU:
+      replacer_ = new PartitionedLRUReplacer(max_pool_size_);
+      break;
+    case ReplacerPolicy::LRU:
+    default:
+      replacer_ = new LRUReplacer(max_pool_size_);
+      break;
+  }
 
   // Initially, every page is in the free list.
   for (size_t i = 0; i < pool_size_; ++i) {
     free_list_.emplace_back(static_cast<int>(i));
   }
+  for (auto &page_id : frame_page_ids_) {
+    page_id = INVALID_PAGE_ID;
+  }
+  for (auto &version : frame_versions_) {
+    version = 1;  // 空闲页框不可读
+  }
+  for (auto &hint : location_hints_) {
+    hint = static_cast<uint64_t>(static_cast<uint32_t>(INVALID_PAGE_ID)) << 32;
+  }
+  for (auto &pins : swizzle_pins_) {
+    pins = SWIZZLE_PINS_LOCKED;  // 空闲页框不能通过swizzle引用pin
+  }
+  frame_retiring_.resize(max_pool_size_, false);
+  num_free_frames_ = pool_size;
 }
 
 BufferPoolManagerInstance::~BufferPoolManagerInstance() {
-  delete[] pages_;
+  StopWarmUp();
+  StopWarmUpDumps();
+  StopPrefetchers();
+  StopBackgroundFlusher();
+  disk_io_.reset();  // 等待进行中的I/O完成，其回调会访问页框
   delete replacer_;
 }
 
 auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
   // Make sure you call DiskManager::WritePage!
-  std::lock_guard<std::mutex> lock(latch_);  // 加锁
-  if (page_table_.count(page_id) == 0) {
-    return false;
+  frame_id_t frame_id;
+  {
+    PageTableShard &shard = GetShard(page_id);
+    std::lock_guard<std::mutex> lock(shard.latch_);  // 只需加该页所在分片的锁
+    auto iter = shard.table_.find(page_id);
+    if (iter == shard.table_.end()) {
+      return false;
+    }
+    frame_id = iter->second;
   }
-
-  frame_id_t frame_id = page_table_[page_id];
   /*
-  if (pages_[frame_id].IsDirty()) {
-    disk_manager_->WritePage(page_id, pages_[frame_id].data_);
-    pages_[frame_id].is_dirty_ = false;
+  if (FramePage(frame_id).IsDirty()) {
+    disk_manager_->WritePage(page_id, FramePage(frame_id).data_);
+    FramePage(frame_id).is_dirty_ = false;
   }
   我本来以为只有dirty时才进行页的写入，但parallel_buffer_pool_manager_test.cpp 942-944行的逻辑表明不是这样的
   strcpy(page->GetData(), std::to_string(temp_page_id).c_str());  // NOLINT
@@ -66,42 +126,1017 @@ auto BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) -> bool {
   EXPECT_EQ(1, bpm->FlushPage(temp_page_id, nullptr));
   EXPECT_EQ(1, bpm->UnpinPage(temp_page_id, false, nullptr));
   */
-  disk_manager_->WritePage(page_id, pages_[frame_id].data_);
-  pages_[frame_id].is_dirty_ = false;
-  return true;
+  // 写盘期间不持有分片锁，I/O完成回调可能需要同一个分片锁
+  return FlushFrame(frame_id, page_id, FlushMode::ALWAYS);
 }
 
 void BufferPoolManagerInstance::FlushAllPgsImp() {
   // You can do it!
-  page_id_t page_id;
+  // 先逐个分片收集需要写回的页（脏页，可能有未报告修改的被pin的页，以及从未落盘的新页），只短暂持有分片锁
+  std::vector<std::pair<page_id_t, frame_id_t>> pages;
+  for (auto &shard : page_table_) {
+    std::lock_guard<std::mutex> lock(shard.latch_);
+    for (const auto &item : shard.table_) {
+      const Page &page = FramePage(item.second);
+      if (page.is_dirty_ || page.pin_count_ > 0 || swizzle_pins_[item.second] > 0 ||
+          frame_io_[item.second] != FrameIOState::IDLE || shard.unpersisted_.count(item.first) > 0) {
+        pages.emplace_back(item);
+      }
+    }
+  }
+  // 按page id顺序分批写回，相邻的页合并成一次写，每批的写请求同时提交
+  std::sort(pages.begin(), pages.end());
+  AlignedPageBuffer buffers(FLUSH_BATCH_SIZE);
+  std::vector<std::pair<page_id_t, frame_id_t>> batch;
+  std::vector<std::pair<page_id_t, frame_id_t>> busy;
+  for (const auto &[page_id, frame_id] : pages) {
+    FlushStart start = BeginFlush(frame_id, page_id, FlushMode::CHECKPOINT, buffers.At(batch.size()), false);
+    if (start == FlushStart::NEEDS_LATCH) {
+      // 等待页锁之前先写完已开始的写回，持有页锁的线程可能正在等待其中某个页写回结束
+      WriteFlushBatch(batch, &buffers);
+      batch.clear();
+      start = BeginFlush(frame_id, page_id, FlushMode::CHECKPOINT, buffers.At(0), true);
+    }
+    if (start == FlushStart::STARTED) {
+      batch.emplace_back(page_id, frame_id);
+    } else {
+      busy.emplace_back(page_id, frame_id);
+    }
+    if (batch.size() == FLUSH_BATCH_SIZE) {
+      WriteFlushBatch(batch, &buffers);
+      batch.clear();
+    }
+  }
+  WriteFlushBatch(batch, &buffers);
+  // 收集之后开始了写回的页，等写回结束再检查一次
+  for (const auto &[page_id, frame_id] : busy) {
+    FlushFrame(frame_id, page_id, FlushMode::CHECKPOINT);
+  }
+}
+
+auto BufferPoolManagerInstance::GetHottestPages(size_t count) -> std::vector<PageHeat> {
+  std::vector<PageHeat> pages;
+  for (auto &shard : page_table_) {
+    std::lock_guard<std::mutex> lock(shard.latch_);
+    for (const auto &[page_id, frame_id] : shard.table_) {
+      pages.push_back({page_id, frame_fetches_[frame_id]});
+    }
+  }
+  count = std::min(count, pages.size());
+  std::partial_sort(pages.begin(), pages.begin() + count, pages.end(),
+                    [](const PageHeat &a, const PageHeat &b) { return a.fetches_ > b.fetches_; });
+  pages.resize(count);
+  return pages;
+}
+
+auto BufferPoolManagerInstance::TryOptimisticRead(page_id_t page_id, OptimisticRead *read) -> bool {
+  if (page_id == INVALID_PAGE_ID) {
+    return false;
+  }
+  std::atomic<uint64_t> &hint = LocationHint(page_id);
+  uint64_t location = hint.load(std::memory_order_acquire);
   frame_id_t frame_id;
-  std::lock_guard<std::mutex> lock(latch_);  // 加锁
-  for (const auto &item : page_table_) {
-    page_id = item.first;
-    frame_id = item.second;
-    disk_manager_->WritePage(page_id, pages_[frame_id].data_);
-    pages_[frame_id].is_dirty_ = false;
+  if (static_cast<page_id_t>(location >> 32) == page_id) {
+    frame_id = static_cast<frame_id_t>(location & 0xffffffff);
+  } else {
+    // 提示未命中，加分片锁查页表并更新提示，只会读不会pin该页
+    PageTableShard &shard = GetShard(page_id);
+    std::lock_guard<std::mutex> lock(shard.latch_);
+    auto iter = shard.table_.find(page_id);
+    if (iter == shard.table_.end()) {
+      return false;
+    }
+    frame_id = iter->second;
+    hint.store(static_cast<uint64_t>(page_id) << 32 | static_cast<uint32_t>(frame_id), std::memory_order_release);
+  }
+  // 先读版本再确认页框中是哪个页；之后页框换页或被修改都会改变版本，校验时就会失败
+  uint64_t version = frame_versions_[frame_id].load(std::memory_order_acquire);
+  if ((version & 1) != 0 || frame_page_ids_[frame_id].load(std::memory_order_acquire) != page_id) {
+    return false;
+  }
+  *read = OptimisticRead(FramePage(frame_id).data_, &frame_versions_[frame_id], version);
+  return true;
+}
+
+void BufferPoolManagerInstance::BeginPageWrite(Page *page) {
+  InvalidateFrame(static_cast<frame_id_t>(frame_arena_->FrameId(page)));
+}
+
+void BufferPoolManagerInstance::EndPageWrite(Page *page) {
+  std::atomic<uint64_t> &version = frame_versions_[frame_arena_->FrameId(page)];
+  uint64_t current = version.load(std::memory_order_relaxed);
+  if ((current & 1) != 0) {
+    version.store(current + 1, std::memory_order_release);
+  }
+}
+
+void BufferPoolManagerInstance::InvalidateFrame(frame_id_t frame_id) {
+  std::atomic<uint64_t> &version = frame_versions_[frame_id];
+  uint64_t current = version.load(std::memory_order_relaxed);
+  if ((current & 1) == 0) {
+    version.store(current + 1, std::memory_order_relaxed);
+    // 保证版本变为奇数先于之后对页内容的修改被其他线程看到
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+}
+
+void BufferPoolManagerInstance::PublishFrame(frame_id_t frame_id, page_id_t page_id) {
+  std::atomic<uint64_t> &version = frame_versions_[frame_id];
+  uint64_t current = version.load(std::memory_order_relaxed);
+  if ((current & 1) != 0) {
+    version.store(current + 1, std::memory_order_release);
+  }
+  LocationHint(page_id).store(static_cast<uint64_t>(page_id) << 32 | static_cast<uint32_t>(frame_id),
+                              std::memory_order_release);
+  std::atomic<int32_t> &pins = swizzle_pins_[frame_id];
+  if (pins.load() < 0) {
+    pins.fetch_sub(SWIZZLE_PINS_LOCKED);  // 解锁，此后该页的swizzle引用可以pin
+  }
+}
+
+auto BufferPoolManagerInstance::LockSwizzlePins(frame_id_t frame_id) -> bool {
+  std::atomic<int32_t> &pins = swizzle_pins_[frame_id];
+  if (pins.load() < 0) {
+    return true;
+  }
+  // 与PinSwizzled的fetch_add是同一变量上的原子操作，二者先后确定：加锁在先则pin失败，pin在先则加锁失败
+  int32_t expected = 0;
+  return pins.compare_exchange_strong(expected, SWIZZLE_PINS_LOCKED);
+}
+
+auto BufferPoolManagerInstance::PinSwizzled(Page *page, page_id_t page_id) -> bool {
+  // 引用可能来自其他实例，按地址判断是否是本实例的页框
+  auto offset = reinterpret_cast<uintptr_t>(page) - reinterpret_cast<uintptr_t>(frame_arena_->Frames());
+  size_t stride = frame_arena_->Stride();
+  if (offset >= max_pool_size_ * stride || offset % stride != 0) {
+    return false;
+  }
+  auto frame_id = static_cast<frame_id_t>(offset / stride);
+  std::atomic<int32_t> &pins = swizzle_pins_[frame_id];
+  // 计数为负说明页框已加锁，页已被换出或删除；未加锁时页框中的页不会改变，再确认是不是要找的页
+  if (pins.fetch_add(1) < 0 || frame_page_ids_[frame_id].load() != page_id) {
+    pins.fetch_sub(1);
+    return false;
+  }
+  // swizzle引用不经过replacer，抽样告知replacer该页被访问，热页不会漂到淘汰端；不是每次都报告，避免争用replacer的锁
+  thread_local uint32_t swizzled_pins = 0;
+  if (++swizzled_pins % SWIZZLE_REFERENCE_SAMPLE_RATE == 0) {
+    replacer_->RecordReference(frame_id);
+  }
+  BufferPoolCounters::Increment(&stats_.fetch_hits_);
+  return true;
+}
+
+void BufferPoolManagerInstance::UnpinSwizzled(Page *page, bool is_dirty) {
+  auto frame_id = static_cast<frame_id_t>(frame_arena_->FrameId(page));
+  if (is_dirty) {
+    // 先置脏位再减计数，淘汰线程看到计数归零时一定也看到了脏位
+    PageTableShard &shard = GetShard(frame_page_ids_[frame_id]);
+    std::lock_guard<std::mutex> lock(shard.latch_);
+    if (!page->is_dirty_) {
+      page->is_dirty_ = true;
+      num_dirty_++;
+    }
+  }
+  swizzle_pins_[frame_id].fetch_sub(1);
+}
+
+auto BufferPoolManagerInstance::LocationHint(page_id_t page_id) -> std::atomic<uint64_t> & {
+  return location_hints_[(static_cast<uint32_t>(page_id) / num_instances_) % location_hints_.size()];
+}
+
+auto BufferPoolManagerInstance::LockLatch() -> std::unique_lock<std::mutex> {
+  std::unique_lock<std::mutex> lock(latch_, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    // 只在有竞争时计时，无竞争的加锁不读时钟
+    auto start = std::chrono::steady_clock::now();
+    lock.lock();
+    auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    BufferPoolCounters::Increment(&stats_.latch_waits_);
+    stats_.latch_wait_ns_.fetch_add(wait.count(), std::memory_order_relaxed);
+  }
+  return lock;
+}
+
+auto BufferPoolManagerInstance::GetShard(page_id_t page_id) -> PageTableShard & {
+  // 本实例的page id都模num_instances_同余，先除掉再取模，使各分片均匀
+  return page_table_[(static_cast<uint32_t>(page_id) / num_instances_) % PAGE_TABLE_SHARD_COUNT];
+}
+
+auto BufferPoolManagerInstance::PinResident(page_id_t page_id) -> Page * {
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> lock(shard.latch_);
+  auto iter = shard.table_.find(page_id);
+  // 正在淘汰的页不能再pin，等写回结束后重新查找（此时已不在页表中，需重新从磁盘读入）
+  while (iter != shard.table_.end() && frame_io_[iter->second] == FrameIOState::EVICTING) {
+    shard.io_done_.wait(lock);
+    iter = shard.table_.find(page_id);
+  }
+  if (iter == shard.table_.end()) {
+    return nullptr;
+  }
+  frame_id_t frame_id = iter->second;
+  Page &page = FramePage(frame_id);
+  frame_fetches_[frame_id]++;
+  // 只有pin_count为0才有可能在replacer里；被pin之后由unpin负责放回replacer
+  if (page.pin_count_++ == 0) {
+    replacer_->Pin(frame_id);
+    frame_unlisted_[frame_id] = 0;
   }
+  // 其他线程正在读入该页，pin住之后在该页框上等待读入完成，不阻塞整个缓冲池
+  if (frame_io_[frame_id] == FrameIOState::LOADING) {
+    shard.io_done_.wait(lock, [&] { return frame_io_[frame_id] != FrameIOState::LOADING; });
+    iter = shard.table_.find(page_id);
+    if (iter == shard.table_.end() || iter->second != frame_id) {
+      // 读入失败，该页已从页表中移除；放掉自己的pin，最后一个放掉pin的线程释放页框
+      bool last = --page.pin_count_ == 0;
+      lock.unlock();
+      if (last) {
+        ReleaseFrame(frame_id);
+      }
+      return nullptr;
+    }
+  }
+  return &page;
+}
+
+auto BufferPoolManagerInstance::StartLoad(frame_id_t frame_id, page_id_t page_id, bool *persisted) -> bool {
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> shard_lock(shard.latch_);
+  if (shard.table_.count(page_id) > 0) {
+    shard_lock.unlock();
+    ReleaseFrame(frame_id);
+    return false;
+  }
+  // 先以LOADING状态放入页表，同一页的并发请求在该页框上等待，而不是重复读入
+  shard.table_[page_id] = frame_id;
+  frame_io_[frame_id] = FrameIOState::LOADING;
+  FramePage(frame_id).is_dirty_ = false;
+  FramePage(frame_id).page_id_ = page_id;
+  FramePage(frame_id).pin_count_ = 1;
+  frame_page_ids_[frame_id] = page_id;
+  frame_fetches_[frame_id] = 0;
+  replacer_->ResetHistory(frame_id);  // 页框换了页，不能沿用旧页的访问历史
+  *persisted = shard.unpersisted_.count(page_id) == 0;
+  return true;
+}
+
+auto BufferPoolManagerInstance::FinishLoad(frame_id_t frame_id, page_id_t page_id, bool ok) -> bool {
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> shard_lock(shard.latch_);
+  frame_io_[frame_id] = FrameIOState::IDLE;
+  shard.io_done_.notify_all();
+  if (ok) {
+    PublishFrame(frame_id, page_id);
+    return true;
+  }
+  // 读入失败的页不能被访问：从页表中移除，页框不发布，等待该页的线程醒来后放掉各自的pin
+  shard.table_.erase(page_id);
+  if (--FramePage(frame_id).pin_count_ == 0) {
+    shard_lock.unlock();
+    ReleaseFrame(frame_id);
+  }
+  return false;
+}
+
+void BufferPoolManagerInstance::ReleaseFrame(frame_id_t frame_id) {
+  FramePage(frame_id).page_id_ = INVALID_PAGE_ID;
+  frame_page_ids_[frame_id] = INVALID_PAGE_ID;
+  FramePage(frame_id).pin_count_ = 0;
+  FramePage(frame_id).is_dirty_ = false;
+  std::unique_lock<std::mutex> lock = LockLatch();
+  if (static_cast<size_t>(frame_id) >= pool_size_) {  // 页框正在被ResizePool移除
+    RetireFrame(frame_id);
+    return;
+  }
+  free_list_.emplace_back(frame_id);
+  num_free_frames_++;
 }
 
 frame_id_t BufferPoolManagerInstance::GetFrame() {
-  frame_id_t frame_id;
-  if (!free_list_.empty()) {  // 存在空余页
-    frame_id = free_list_.back();
-    free_list_.pop_back();
-  } else {  // 需根据LRU算法淘汰一页
-    bool res = replacer_->Victim(&frame_id);
-    if (!res) {  // 淘汰失败
-      return NUMLL_FRAME;
+  frame_id_t frame_id = NUMLL_FRAME;
+  // 被swizzle pin的页框在找到页框后才放回replacer，否则它仍排在淘汰顺序的最前面，会被立即再次选中
+  std::vector<frame_id_t> swizzle_pinned;
+  // 写回失败的脏页会放回replacer，磁盘持续出错时限制放弃的次数，避免一直循环
+  size_t abandoned = 0;
+  std::unique_lock<std::mutex> lock = LockLatch();
+  while (true) {
+    if (!free_list_.empty()) {  // 存在空余页
+      frame_id = free_list_.back();
+      free_list_.pop_back();
+      num_free_frames_--;
+      break;
     }
-    page_id_t victim_page_id = pages_[frame_id].page_id_;
-    if (pages_[frame_id].IsDirty()) {
-      disk_manager_->WritePage(victim_page_id, pages_[frame_id].data_);
+    // 需根据LRU算法淘汰一页
+    if (!replacer_->Victim(&frame_id)) {
+      frame_id = NUMLL_FRAME;  // 淘汰失败
+      break;
     }
-    page_table_.erase(victim_page_id);  // 在page_table中删除该frame对应的页
+    if (swizzle_pins_[frame_id] > 0) {
+      swizzle_pinned.push_back(frame_id);
+      continue;
+    }
+    // 在replacer中的页框一定在页表中且没有进行中的I/O，持有latch_时其page_id_不会改变
+    if (!EvictFrame(frame_id, FramePage(frame_id).page_id_, &lock, true)) {
+      if (++abandoned > pool_size_) {
+        frame_id = NUMLL_FRAME;
+        break;
+      }
+      continue;
+    }
+    if (!lock.owns_lock()) {
+      lock.lock();  // 写回脏页时释放了latch_
+    }
+    if (static_cast<size_t>(frame_id) < pool_size_) {
+      break;
+    }
+    RetireFrame(frame_id);  // 淘汰出的是正在被移除的页框，不能再使用
+  }
+  for (frame_id_t pinned : swizzle_pinned) {
+    replacer_->Unpin(pinned);
   }
   return frame_id;
 }
+
+auto BufferPoolManagerInstance::EvictFrame(frame_id_t frame_id, page_id_t page_id, std::unique_lock<std::mutex> *lock,
+                                           bool unlisted) -> bool {
+  Page &victim = FramePage(frame_id);
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> shard_lock(shard.latch_);
+  auto iter = shard.table_.find(page_id);
+  if (iter == shard.table_.end() || iter->second != frame_id) {
+    return false;
+  }
+  // 正在写回的页不能淘汰；从replacer中取出的页框记下来，写回结束时由EndFlush放回
+  if (frame_io_[frame_id] == FrameIOState::FLUSHING) {
+    if (unlisted && victim.pin_count_ == 0) {
+      frame_unlisted_[frame_id] = 1;
+    }
+    return false;
+  }
+  if (frame_io_[frame_id] != FrameIOState::IDLE) {
+    return false;
+  }
+  // Victim之后、加分片锁之前，命中路径可能已经重新pin了该页，此时放弃它换下一个
+  // 该页框已不在replacer中，等pin_count归零时Unpin会把它放回
+  if (victim.pin_count_ > 0) {
+    return false;
+  }
+  // 被swizzle pin的页框没有被淘汰，从replacer中取出的需放回
+  if (!LockSwizzlePins(frame_id)) {
+    if (unlisted) {
+      replacer_->Unpin(frame_id);
+    }
+    return false;
+  }
+  // 若期间该页被pin后又unpin到0，页框会被重新放回replacer，需要再次移除
+  replacer_->Pin(frame_id);
+  BufferPoolCounters::Increment(&stats_.evictions_);
+  if (!victim.IsDirty()) {
+    InvalidateFrame(frame_id);
+    shard.table_.erase(iter);  // 在page_table中删除该frame对应的页
+    return true;
+  }
+  BufferPoolCounters::Increment(&stats_.dirty_evictions_);
+  // 脏页写回期间该页仍留在页表中并标记为EVICTING，并发访问该页的线程在页框上等待，写回时不持有任何锁
+  frame_io_[frame_id] = FrameIOState::EVICTING;
+  victim.is_dirty_ = false;
+  num_dirty_--;
+  shard_lock.unlock();
+  lock->unlock();
+
+  auto start = std::chrono::steady_clock::now();
+  bool written = disk_io_->WritePage(page_id, victim.data_);
+  stats_.write_latency_.Record(std::chrono::steady_clock::now() - start);
+
+  shard_lock.lock();
+  if (!written) {
+    // 写回失败，该页留在缓冲池中：恢复脏位，重新允许swizzle pin，未被pin时放回replacer
+    if (!victim.is_dirty_) {
+      victim.is_dirty_ = true;
+      num_dirty_++;
+    }
+    frame_io_[frame_id] = FrameIOState::IDLE;
+    PublishFrame(frame_id, page_id);
+    if (victim.pin_count_ == 0) {
+      replacer_->Unpin(frame_id);
+    }
+    shard.io_done_.notify_all();
+    shard_lock.unlock();
+    lock->lock();
+    return false;
+  }
+  shard.unpersisted_.erase(page_id);
+  InvalidateFrame(frame_id);  // 写回期间页的内容没有变，仍可以乐观读
+  shard.table_.erase(page_id);
+  frame_io_[frame_id] = FrameIOState::IDLE;
+  shard.io_done_.notify_all();
+  return true;
+}
+
+auto BufferPoolManagerInstance::GetScanFrame(ScanRing *ring) -> frame_id_t {
+  ScanRing::InstanceRing &instance_ring = ring->rings_[this];
+  if (instance_ring.slots_.size() < ring->ring_size_) {  // 环还没满，正常分配
+    return GetFrame();
+  }
+  // 环满后复用最早的槽位，该页框已不被使用时直接淘汰，不经过replacer
+  const ScanRing::Slot &slot = instance_ring.slots_[instance_ring.next_];
+  {
+    std::unique_lock<std::mutex> lock = LockLatch();
+    // 缓冲池缩小后，槽位中的页框可能已被移除
+    if (static_cast<size_t>(slot.frame_id_) < pool_size_ && EvictFrame(slot.frame_id_, slot.page_id_, &lock, false)) {
+      return slot.frame_id_;
+    }
+  }
+  // 该页被其他线程使用中或已被换出，退回到普通分配，之后由新页框顶替该槽位
+  return GetFrame();
+}
+
+void BufferPoolManagerInstance::RecordScanFrame(ScanRing *ring, frame_id_t frame_id, page_id_t page_id) {
+  ScanRing::InstanceRing &instance_ring = ring->rings_[this];
+  if (instance_ring.slots_.size() < ring->ring_size_) {
+    instance_ring.slots_.push_back({frame_id, page_id});
+    return;
+  }
+  instance_ring.slots_[instance_ring.next_] = {frame_id, page_id};
+  instance_ring.next_ = (instance_ring.next_ + 1) % ring->ring_size_;
+}
+
+auto BufferPoolManagerInstance::BeginFlush(frame_id_t frame_id, page_id_t page_id, FlushMode mode, char *buffer,
+                                           bool may_latch) -> FlushStart {
+  Page &page = FramePage(frame_id);
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> shard_lock(shard.latch_);
+  bool latched = false;
+  while (true) {
+    auto iter = shard.table_.find(page_id);
+    if (iter == shard.table_.end() || iter->second != frame_id || frame_io_[frame_id] != FrameIOState::IDLE) {
+      break;
+    }
+    // 被pin的页可能有尚未通过unpin报告的修改，从未落盘的页重启后会丢失，检查点都要写回
+    bool pinned = page.pin_count_ > 0 || swizzle_pins_[frame_id] > 0;
+    bool unpersisted = shard.unpersisted_.count(page_id) > 0;
+    bool write =
+        mode == FlushMode::ALWAYS || page.IsDirty() || (mode == FlushMode::CHECKPOINT && (pinned || unpersisted));
+    if (!write || (mode == FlushMode::UNPINNED_DIRTY && pinned)) {
+      break;
+    }
+    // 没有被pin的页不会有人修改：持有分片锁时不能被pin，锁住swizzle pin后也不能通过swizzle引用访问，直接复制
+    int32_t unpinned = 0;
+    bool copy_now = latched || (page.pin_count_ == 0 &&
+                                swizzle_pins_[frame_id].compare_exchange_strong(unpinned, SWIZZLE_PINS_LOCKED));
+    if (!copy_now) {
+      if (!may_latch) {
+        return FlushStart::NEEDS_LATCH;
+      }
+      // 页锁可能被等待FLUSHING页的线程持有，先加页锁再标记FLUSHING，等锁时本页还不是FLUSHING
+      shard_lock.unlock();
+      page.RLatch();
+      latched = true;
+      shard_lock.lock();
+      continue;  // 等锁期间该页可能被换出或开始了其他I/O，重新检查
+    }
+    // 写回期间该页仍可以被pin，但不能被淘汰或删除；先清除脏位，写回期间的修改会在unpin时重新置脏
+    frame_io_[frame_id] = FrameIOState::FLUSHING;
+    if (page.is_dirty_) {
+      page.is_dirty_ = false;
+      num_dirty_--;
+    }
+    memcpy(buffer, page.data_, PAGE_SIZE);
+    if (!latched) {
+      swizzle_pins_[frame_id].fetch_sub(SWIZZLE_PINS_LOCKED);
+    }
+    shard_lock.unlock();
+    if (latched) {
+      page.RUnlatch();  // 复制后立即释放页锁，一批页写回期间不持有任何页锁
+    }
+    return FlushStart::STARTED;
+  }
+  shard_lock.unlock();
+  if (latched) {
+    page.RUnlatch();
+  }
+  return FlushStart::SKIPPED;
+}
+
+void BufferPoolManagerInstance::EndFlush(frame_id_t frame_id, page_id_t page_id, bool ok) {
+  PageTableShard &shard = GetShard(page_id);
+  std::lock_guard<std::mutex> shard_lock(shard.latch_);
+  if (ok) {
+    shard.unpersisted_.erase(page_id);
+  } else if (!FramePage(frame_id).is_dirty_) {  // 写回失败，BeginFlush清除的脏位要恢复，否则修改会在淘汰时丢失
+    FramePage(frame_id).is_dirty_ = true;
+    num_dirty_++;
+  }
+  frame_io_[frame_id] = FrameIOState::IDLE;
+  // 写回期间淘汰线程把该页框从replacer中取出又放弃了，未被pin时放回；其他页框仍在replacer中，不能重复放入
+  if (frame_unlisted_[frame_id] != 0) {
+    frame_unlisted_[frame_id] = 0;
+    if (FramePage(frame_id).pin_count_ == 0) {
+      replacer_->Unpin(frame_id);
+    }
+  }
+  shard.io_done_.notify_all();
+}
+
+auto BufferPoolManagerInstance::WriteFlushBatch(const std::vector<std::pair<page_id_t, frame_id_t>> &batch,
+                                                AlignedPageBuffer *buffers) -> bool {
+  if (batch.empty()) {
+    return true;
+  }
+  // 缓冲区中相邻的页在磁盘上也相邻时合并成一个请求，记下每个页属于哪个请求
+  std::vector<DiskRequest> requests;
+  std::vector<size_t> request_of(batch.size());
+  for (size_t i = 0; i < batch.size(); i++) {
+    if (i > 0 && batch[i].first == batch[i - 1].first + 1) {
+      requests.back().page_count_++;
+    } else {
+      requests.push_back({true, batch[i].first, buffers->At(i), nullptr});
+    }
+    request_of[i] = requests.size() - 1;
+  }
+  // SubmitAndWait返回前所有回调都已执行完，回调中写入的结果对本线程可见
+  std::vector<uint8_t> written(requests.size(), 0);
+  for (size_t r = 0; r < requests.size(); r++) {
+    requests[r].callback_ = [&written, r](bool ok) { written[r] = ok ? 1 : 0; };
+  }
+  auto start = std::chrono::steady_clock::now();
+  bool all_written = disk_io_->SubmitAndWait(&requests);
+  auto latency = std::chrono::steady_clock::now() - start;
+  size_t flushed = 0;
+  for (size_t i = 0; i < batch.size(); i++) {
+    stats_.write_latency_.Record(latency);
+    bool ok = written[request_of[i]] != 0;
+    EndFlush(batch[i].second, batch[i].first, ok);
+    flushed += ok ? 1 : 0;
+  }
+  stats_.flushed_pages_.fetch_add(flushed, std::memory_order_relaxed);
+  return all_written;
+}
+
+auto BufferPoolManagerInstance::FlushFrame(frame_id_t frame_id, page_id_t page_id, FlushMode mode) -> bool {
+  {
+    // 正在读入的页内容还不完整，正在淘汰的页写回完成后就不在页表中了，正在写回的页等它写完再检查是否还需要写
+    PageTableShard &shard = GetShard(page_id);
+    std::unique_lock<std::mutex> shard_lock(shard.latch_);
+    shard.io_done_.wait(shard_lock, [&] {
+      auto iter = shard.table_.find(page_id);
+      return iter == shard.table_.end() || iter->second != frame_id || frame_io_[frame_id] == FrameIOState::IDLE;
+    });
+  }
+  // 单页写回很频繁，每个线程复用一个对齐的缓冲区
+  static thread_local AlignedPageBuffer buffer(1);
+  if (BeginFlush(frame_id, page_id, mode, buffer.At(0), true) != FlushStart::STARTED) {
+    return false;
+  }
+  return WriteFlushBatch({{page_id, frame_id}}, &buffer);
+}
+
+void BufferPoolManagerInstance::BackgroundFlushRound(size_t pages_per_round, double dirty_watermark) {
+  if (static_cast<double>(num_dirty_.load()) <= dirty_watermark * static_cast<double>(pool_size_)) {
+    return;
+  }
+  std::vector<frame_id_t> frames;
+  replacer_->PeekVictims(pages_per_round * BACKGROUND_FLUSH_LOOKAHEAD, &frames);
+  // 一轮要写回的页一起提交
+  AlignedPageBuffer buffers(pages_per_round);
+  std::vector<std::pair<page_id_t, frame_id_t>> batch;
+  for (frame_id_t frame_id : frames) {
+    if (batch.size() == pages_per_round) {
+      break;
+    }
+    page_id_t page_id = frame_page_ids_[frame_id].load();
+    // 只写回没有被pin的页，不会等待页锁
+    if (page_id != INVALID_PAGE_ID && BeginFlush(frame_id, page_id, FlushMode::UNPINNED_DIRTY,
+                                                 buffers.At(batch.size()), false) == FlushStart::STARTED) {
+      batch.emplace_back(page_id, frame_id);
+    }
+  }
+  WriteFlushBatch(batch, &buffers);
+}
+
+void BufferPoolManagerInstance::StartBackgroundFlusher(std::chrono::milliseconds interval, size_t pages_per_round,
+                                                       double dirty_watermark) {
+  StopBackgroundFlusher();
+  flusher_running_ = true;
+  flusher_ = std::thread([this, interval, pages_per_round, dirty_watermark] {
+    std::unique_lock<std::mutex> lock(flusher_mutex_);
+    while (!flusher_cv_.wait_for(lock, interval, [this] { return !flusher_running_; })) {
+      lock.unlock();
+      BackgroundFlushRound(pages_per_round, dirty_watermark);
+      lock.lock();
+    }
+  });
+}
+
+void BufferPoolManagerInstance::StopBackgroundFlusher() {
+  {
+    std::lock_guard<std::mutex> lock(flusher_mutex_);
+    flusher_running_ = false;
+  }
+  flusher_cv_.notify_all();
+  if (flusher_.joinable()) {
+    flusher_.join();
+  }
+}
+
+auto BufferPoolManagerInstance::IsAllocatedHere(page_id_t page_id) const -> bool {
+  return page_id >= 0 && page_id < next_page_id_ && static_cast<uint32_t>(page_id) % num_instances_ == instance_index_;
+}
+
+void BufferPoolManagerInstance::PrefetchPage(page_id_t page_id) {
+  // 只预取属于本实例且已经分配过的页
+  if (IsAllocatedHere(page_id)) {
+    EnqueuePrefetch(page_id, false);
+  }
+}
+
+void BufferPoolManagerInstance::PrefetchScanPage(page_id_t page_id) {
+  if (IsAllocatedHere(page_id)) {
+    EnqueuePrefetch(page_id, true);
+  }
+}
+
+void BufferPoolManagerInstance::PrefetchRange(page_id_t first_page_id, size_t count) {
+  if (first_page_id < 0) {
+    return;
+  }
+  // 找到范围内第一个属于本实例的页，之后每隔num_instances_个页一个
+  uint32_t first_index = static_cast<uint32_t>(first_page_id) % num_instances_;
+  uint32_t skip = (instance_index_ + num_instances_ - first_index) % num_instances_;
+  page_id_t page_id = first_page_id + static_cast<page_id_t>(skip);
+  page_id_t end_page_id = first_page_id + static_cast<page_id_t>(count);
+  for (; page_id < end_page_id && page_id < next_page_id_; page_id += num_instances_) {
+    if (!EnqueuePrefetch(page_id, false)) {
+      break;
+    }
+  }
+}
+
+auto BufferPoolManagerInstance::EnqueuePrefetch(page_id_t page_id, bool scan) -> bool {
+  std::lock_guard<std::mutex> lock(prefetch_mutex_);
+  if (prefetch_stopped_ || prefetch_queue_.size() >= PREFETCH_QUEUE_CAPACITY) {
+    return false;  // 预取只是提示，队列满时直接丢弃
+  }
+  if (prefetchers_.empty()) {
+    for (size_t i = 0; i < PREFETCH_THREAD_COUNT; i++) {
+      prefetchers_.emplace_back([this] {
+        std::unique_lock<std::mutex> lock(prefetch_mutex_);
+        while (true) {
+          prefetch_cv_.wait(lock, [this] { return prefetch_stopped_ || !prefetch_queue_.empty(); });
+          if (prefetch_stopped_) {
+            return;
+          }
+          // 一次取出多个请求，读请求一起提交；扫描的预读与其他预取使用不同的页框来源，分开处理
+          std::vector<page_id_t> page_ids;
+          std::vector<page_id_t> scan_page_ids;
+          for (size_t i = 0; i < PrefetchBatchSize() && !prefetch_queue_.empty(); i++) {
+            PrefetchRequest request = prefetch_queue_.front();
+            prefetch_queue_.pop_front();
+            (request.scan_ ? scan_page_ids : page_ids).push_back(request.page_id_);
+          }
+          lock.unlock();
+          PrefetchPgImp(page_ids);
+          PrefetchPgImp(scan_page_ids, true);
+          lock.lock();
+        }
+      });
+    }
+  }
+  prefetch_queue_.push_back({page_id, scan});
+  prefetch_cv_.notify_one();
+  return true;
+}
+
+void BufferPoolManagerInstance::PrefetchPgImp(const std::vector<page_id_t> &page_ids, bool scan, bool wait) {
+  std::vector<DiskRequest> requests;
+  // 扫描的预读与扫描线程的缺页一样，只在一个小环内循环使用页框，该环由各预取线程共用
+  std::unique_lock<std::mutex> ring_lock(prefetch_ring_mutex_, std::defer_lock);
+  if (scan) {
+    ring_lock.lock();
+  }
+  for (page_id_t page_id : page_ids) {
+    {
+      PageTableShard &shard = GetShard(page_id);
+      std::lock_guard<std::mutex> shard_lock(shard.latch_);
+      if (shard.table_.count(page_id) > 0) {  // 已在缓冲池中，不重复读入，也不影响replacer中的顺序
+        continue;
+      }
+    }
+    frame_id_t frame_id = scan ? GetScanFrame(&prefetch_ring_) : GetFrame();
+    if (frame_id == NUMLL_FRAME) {
+      break;
+    }
+    bool persisted;
+    if (!StartLoad(frame_id, page_id, &persisted)) {
+      continue;
+    }
+    if (scan) {
+      RecordScanFrame(&prefetch_ring_, frame_id, page_id);
+    }
+    BufferPoolCounters::Increment(&stats_.prefetched_pages_);
+    // 读入完成后立即unpin，之后对该页的访问就是命中；读入失败时FinishLoad已放掉读入者的pin
+    auto finish = [this, frame_id, page_id](bool ok) {
+      if (FinishLoad(frame_id, page_id, ok)) {
+        UnpinPgImp(page_id, false);
+      }
+    };
+    if (persisted) {
+      auto start = std::chrono::steady_clock::now();
+      auto read_done = [this, start, finish](bool ok) {
+        stats_.read_latency_.Record(std::chrono::steady_clock::now() - start);
+        finish(ok);
+      };
+      requests.push_back({false, page_id, FramePage(frame_id).data_, read_done});
+    } else {
+      FramePage(frame_id).ResetMemory();
+      finish(true);
+    }
+  }
+  if (scan) {
+    ring_lock.unlock();
+  }
+  if (wait) {
+    disk_io_->SubmitAndWait(&requests);
+  } else {
+    disk_io_->Submit(&requests);
+  }
+}
+
+auto BufferPoolManagerInstance::PrefetchBatchSize() const -> size_t {
+  // 读入期间页框处于pin状态，小缓冲池少占一些页框
+  return std::max<size_t>(1, std::min(PREFETCH_BATCH_SIZE, pool_size_ / 16));
+}
+
+void BufferPoolManagerInstance::StopPrefetchers() {
+  {
+    std::lock_guard<std::mutex> lock(prefetch_mutex_);
+    prefetch_stopped_ = true;
+    prefetch_queue_.clear();
+  }
+  prefetch_cv_.notify_all();
+  for (auto &prefetcher : prefetchers_) {
+    prefetcher.join();
+  }
+}
+
+auto BufferPoolManagerInstance::ResizePool(size_t pool_size, std::chrono::milliseconds drain_timeout) -> bool {
+  if (pool_size == 0 || pool_size > max_pool_size_) {
+    return false;
+  }
+  std::lock_guard<std::mutex> resize_lock(resize_mutex_);
+  size_t old_pool_size = pool_size_;
+  if (pool_size >= old_pool_size) {
+    // 先构造新页框，再放入空闲列表
+    frame_arena_->Resize(pool_size);
+    std::lock_guard<std::mutex> lock(latch_);
+    for (size_t i = old_pool_size; i < pool_size; i++) {
+      free_list_.emplace_back(static_cast<frame_id_t>(i));
+    }
+    num_free_frames_ += pool_size - old_pool_size;
+    pool_size_ = pool_size;
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lock(latch_);
+  // 降低pool_size_之后，被移除的页框一旦空出来就不会再被使用
+  pool_size_ = pool_size;
+  for (size_t i = pool_size; i < old_pool_size; i++) {
+    frame_retiring_[i] = true;
+  }
+  num_retiring_ = old_pool_size - pool_size;
+  for (auto iter = free_list_.begin(); iter != free_list_.end();) {
+    if (static_cast<size_t>(*iter) >= pool_size) {
+      RetireFrame(*iter);
+      iter = free_list_.erase(iter);
+      num_free_frames_--;
+    } else {
+      ++iter;
+    }
+  }
+  // 把被移除页框中的页迁移到前面的空闲页框或淘汰掉，被pin的页等到unpin之后再处理
+  auto deadline = std::chrono::steady_clock::now() + drain_timeout;
+  while (num_retiring_ > 0) {
+    for (size_t i = pool_size; i < old_pool_size; i++) {
+      if (frame_retiring_[i] && VacateFrame(static_cast<frame_id_t>(i), &lock)) {
+        RetireFrame(static_cast<frame_id_t>(i));
+      }
+    }
+    if (num_retiring_ == 0) {
+      break;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      // 超时，恢复原来的大小，已经空出来的页框放回空闲列表
+      for (size_t i = pool_size; i < old_pool_size; i++) {
+        if (frame_retiring_[i]) {
+          frame_retiring_[i] = false;
+        } else {
+          free_list_.emplace_back(static_cast<frame_id_t>(i));
+          num_free_frames_++;
+        }
+      }
+      num_retiring_ = 0;
+      pool_size_ = old_pool_size;
+      return false;
+    }
+    // unpin不经过latch_，定期重试
+    retired_cv_.wait_for(lock, std::chrono::milliseconds(1));
+  }
+  lock.unlock();
+  // 被移除的页框已不在页表、空闲列表和replacer中，可以析构并释放内存
+  frame_arena_->Resize(pool_size);
+  return true;
+}
+
+auto BufferPoolManagerInstance::VacateFrame(frame_id_t frame_id, std::unique_lock<std::mutex> *lock) -> bool {
+  page_id_t page_id = frame_page_ids_[frame_id];
+  if (page_id == INVALID_PAGE_ID) {
+    return false;  // 页框被其他线程取走了，还没有放入页表
+  }
+  if (free_list_.empty()) {
+    if (!EvictFrame(frame_id, page_id, lock, false)) {
+      return false;
+    }
+    if (!lock->owns_lock()) {
+      lock->lock();
+    }
+  } else {
+    PageTableShard &shard = GetShard(page_id);
+    std::lock_guard<std::mutex> shard_lock(shard.latch_);
+    auto iter = shard.table_.find(page_id);
+    Page &from = FramePage(frame_id);
+    if (iter == shard.table_.end() || iter->second != frame_id || frame_io_[frame_id] != FrameIOState::IDLE ||
+        from.pin_count_ > 0 || !LockSwizzlePins(frame_id)) {
+      return false;
+    }
+    // 未被pin、没有I/O的页不会被其他线程访问，复制到空闲页框后改页表即可，脏页无需写回
+    frame_id_t target = free_list_.back();
+    free_list_.pop_back();
+    num_free_frames_--;
+    Page &to = FramePage(target);
+    InvalidateFrame(frame_id);
+    memcpy(to.data_, from.data_, PAGE_SIZE);
+    to.page_id_ = page_id;
+    to.pin_count_ = 0;
+    to.is_dirty_ = from.is_dirty_;
+    frame_page_ids_[target] = page_id;
+    frame_fetches_[target] = frame_fetches_[frame_id];
+    iter->second = target;
+    PublishFrame(target, page_id);
+    replacer_->Pin(frame_id);
+    replacer_->ResetHistory(target);
+    replacer_->Unpin(target);
+  }
+  FramePage(frame_id).page_id_ = INVALID_PAGE_ID;
+  FramePage(frame_id).is_dirty_ = false;
+  frame_page_ids_[frame_id] = INVALID_PAGE_ID;
+  return true;
+}
+
+void BufferPoolManagerInstance::RetireFrame(frame_id_t frame_id) {
+  if (frame_retiring_[frame_id]) {
+    frame_retiring_[frame_id] = false;
+    num_retiring_--;
+    retired_cv_.notify_all();
+  }
+}
+
+auto BufferPoolManagerInstance::DumpResidentPages(const std::string &path) -> bool {
+  // 被pin的页最近正在使用，排在最前面；未被pin的页按replacer中从新到旧的顺序排在后面
+  std::unordered_map<frame_id_t, page_id_t> resident;
+  for (auto &shard : page_table_) {
+    std::lock_guard<std::mutex> lock(shard.latch_);
+    for (const auto &[page_id, frame_id] : shard.table_) {
+      resident[frame_id] = page_id;
+    }
+  }
+  std::vector<frame_id_t> evictable;
+  replacer_->PeekVictims(max_pool_size_, &evictable);
+  std::vector<page_id_t> unpinned;
+  for (frame_id_t frame_id : evictable) {
+    auto iter = resident.find(frame_id);
+    if (iter != resident.end()) {
+      unpinned.push_back(iter->second);
+      resident.erase(iter);
+    }
+  }
+  std::vector<page_id_t> page_ids;
+  page_ids.reserve(resident.size() + unpinned.size());
+  for (const auto &[frame_id, page_id] : resident) {
+    page_ids.push_back(page_id);
+  }
+  page_ids.insert(page_ids.end(), unpinned.rbegin(), unpinned.rend());
+
+  // 先写临时文件再改名，崩溃时不会留下半个文件
+  std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+    auto count = static_cast<uint32_t>(page_ids.size());
+    out.write(reinterpret_cast<const char *>(&WARM_UP_FILE_MAGIC), sizeof(WARM_UP_FILE_MAGIC));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char *>(page_ids.data()), static_cast<std::streamsize>(count * sizeof(page_id_t)));
+    if (!out.good()) {
+      LOG_DEBUG("failed to write the resident pages to %s", tmp_path.c_str());
+      return false;
+    }
+  }
+  return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+void BufferPoolManagerInstance::StartWarmUpDumps(const std::string &path, std::chrono::milliseconds interval) {
+  StopWarmUpDumps();
+  dump_running_ = true;
+  dump_thread_ = std::thread([this, path, interval] {
+    std::unique_lock<std::mutex> lock(dump_mutex_);
+    while (!dump_cv_.wait_for(lock, interval, [this] { return !dump_running_; })) {
+      lock.unlock();
+      DumpResidentPages(path);
+      lock.lock();
+    }
+    lock.unlock();
+    DumpResidentPages(path);  // 停止时再保存一次，重启后加载的是关闭前的内容
+  });
+}
+
+void BufferPoolManagerInstance::StopWarmUpDumps() {
+  {
+    std::lock_guard<std::mutex> lock(dump_mutex_);
+    dump_running_ = false;
+  }
+  dump_cv_.notify_all();
+  if (dump_thread_.joinable()) {
+    dump_thread_.join();
+  }
+}
+
+auto BufferPoolManagerInstance::WarmUp(const std::string &path, bool wait) -> size_t {
+  std::ifstream in(path, std::ios::binary);
+  uint32_t magic = 0;
+  uint32_t count = 0;
+  in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
+  in.read(reinterpret_cast<char *>(&count), sizeof(count));
+  if (!in.good() || magic != WARM_UP_FILE_MAGIC) {
+    LOG_DEBUG("no resident page dump to warm up from in %s", path.c_str());
+    return 0;
+  }
+  // count来自文件，不可信：最多读文件中实际存在的页号，避免按损坏的count分配内存
+  std::streamoff header_end = in.tellg();
+  in.seekg(0, std::ios::end);
+  auto available = static_cast<size_t>(std::max<std::streamoff>(0, in.tellg() - header_end)) / sizeof(page_id_t);
+  in.seekg(header_end);
+  std::vector<page_id_t> dumped(std::min<size_t>(count, available));
+  in.read(reinterpret_cast<char *>(dumped.data()), static_cast<std::streamsize>(dumped.size() * sizeof(page_id_t)));
+  dumped.resize(static_cast<size_t>(in.gcount()) / sizeof(page_id_t));
+
+  // 文件中越靠前的页越热，只取本实例已分配过的页中能放进缓冲池的部分
+  std::vector<page_id_t> page_ids;
+  for (page_id_t page_id : dumped) {
+    if (page_ids.size() == pool_size_) {
+      break;
+    }
+    if (IsAllocatedHere(page_id)) {
+      page_ids.push_back(page_id);
+    }
+  }
+  std::sort(page_ids.begin(), page_ids.end());
+
+  StopWarmUp();
+  warm_up_stopped_ = false;
+  if (wait) {
+    WarmUpPages(page_ids);
+  } else {
+    warm_up_thread_ = std::thread([this, page_ids] { WarmUpPages(page_ids); });
+  }
+  return page_ids.size();
+}
+
+void BufferPoolManagerInstance::WarmUpPages(const std::vector<page_id_t> &page_ids) {
+  // 按page id顺序分批读入，每批不超过当前的空闲页框数，缓冲池被请求占满后就停止
+  size_t next = 0;
+  while (next < page_ids.size() && !warm_up_stopped_) {
+    size_t batch_size = std::min({WARM_UP_BATCH_SIZE, page_ids.size() - next, num_free_frames_.load()});
+    if (batch_size == 0) {
+      break;
+    }
+    std::vector<page_id_t> batch(page_ids.begin() + next, page_ids.begin() + next + batch_size);
+    PrefetchPgImp(batch, false, true);
+    next += batch_size;
+  }
+}
+
+void BufferPoolManagerInstance::WaitWarmUp() {
+  if (warm_up_thread_.joinable()) {
+    warm_up_thread_.join();
+  }
+}
+
+void BufferPoolManagerInstance::StopWarmUp() {
+  warm_up_stopped_ = true;
+  WaitWarmUp();
+}
+
+void BufferPoolManagerInstance::SetDiskIO(std::unique_ptr<DiskIO> disk_io) { disk_io_ = std::move(disk_io); }
+
 auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
   // 0.   Make sure you call AllocatePage!
   // 1.   If all the pages in the buffer pool are pinned, return nullptr.
@@ -110,25 +1145,35 @@ auto BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) -> Page * {
   // 4.   Set the page ID output parameter. Return a pointer to P.
   frame_id_t frame_id;
   page_id_t new_page_id;
-  std::lock_guard<std::mutex> lock(latch_);  // 加锁
   frame_id = GetFrame();
   if (frame_id == NUMLL_FRAME) {
     return nullptr;
   }
   new_page_id = AllocatePage();
-  page_table_[new_page_id] = frame_id;
 
-  pages_[frame_id].page_id_ = new_page_id;
-  pages_[frame_id].is_dirty_ = false;
-  pages_[frame_id].pin_count_ = 1;
-  pages_[frame_id].ResetMemory();
+  // 页框此时不在页表、空闲列表和replacer中，由当前线程独占，无需加锁
+  FramePage(frame_id).page_id_ = new_page_id;
+  frame_page_ids_[frame_id] = new_page_id;
+  FramePage(frame_id).is_dirty_ = false;
+  FramePage(frame_id).pin_count_ = 1;
+  frame_fetches_[frame_id] = 0;
+  replacer_->ResetHistory(frame_id);
+  FramePage(frame_id).ResetMemory();
   /*
-  创建新页也需要写回磁盘，如果不这样 newpage unpin 然后再被淘汰出去 fetchpage时就会报错（磁盘中并无此页）
-  但不能直接is_dirty_置为true，测试会报错
+  新页不再立即写回磁盘（不能直接is_dirty_置为true，测试会报错），而是记为未落盘：
+  newpage unpin 后未修改就被淘汰出去，再fetchpage时直接清零页框，不从磁盘读取（磁盘中并无此页）
  */
-  disk_manager_->WritePage(pages_[frame_id].page_id_, pages_[frame_id].data_);
+
+  PageTableShard &shard = GetShard(new_page_id);
+  {
+    std::lock_guard<std::mutex> shard_lock(shard.latch_);  // 页框内容准备好后再放入页表
+    shard.table_[new_page_id] = frame_id;
+    shard.unpersisted_.insert(new_page_id);
+    PublishFrame(frame_id, new_page_id);
+  }
   *page_id = new_page_id;
-  return &pages_[frame_id];
+  BufferPoolCounters::Increment(&stats_.new_pages_);
+  return &FramePage(frame_id);
 }
 
 auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
@@ -139,29 +1184,41 @@ auto BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) -> Page * {
   // 2.     If R is dirty, write it back to the disk.
   // 3.     Delete R from the page table and insert P.
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
-  frame_id_t frame_id;
-  std::lock_guard<std::mutex> lock(latch_);  // 加锁
-  if (page_table_.count(page_id) > 0) {      // 原先就在buffer里
-    frame_id = page_table_[page_id];
-    // 只有pin_count为0才有可能在replacer里
-    if (pages_[frame_id].pin_count_ == 0) {
-      replacer_->Pin(frame_id);
+  while (true) {
+    Page *page = PinResident(page_id);  // 原先就在buffer里，命中时不需要实例锁
+    if (page != nullptr) {
+      BufferPoolCounters::Increment(&stats_.fetch_hits_);
+      return page;
     }
-    pages_[frame_id].pin_count_++;
-    return &pages_[frame_id];
-  }
 
-  frame_id = GetFrame();
-  if (frame_id == NUMLL_FRAME) {
-    return nullptr;
-  }
-  page_table_[page_id] = frame_id;
+    // 顺序扫描只在自己的小环内循环使用页框，避免冲掉缓冲池中的热点页
+    ScanRing *ring = ScanRing::Current();
+    frame_id_t frame_id = ring == nullptr ? GetFrame() : GetScanFrame(ring);
+    if (frame_id == NUMLL_FRAME) {
+      return nullptr;
+    }
 
-  pages_[frame_id].is_dirty_ = false;
-  pages_[frame_id].page_id_ = page_id;
-  pages_[frame_id].pin_count_ = 1;
-  disk_manager_->ReadPage(page_id, pages_[frame_id].data_);
-  return &pages_[frame_id];
+    bool persisted;
+    if (!StartLoad(frame_id, page_id, &persisted)) {
+      continue;  // 获取页框期间其他线程已经开始读入该页，按命中处理
+    }
+    BufferPoolCounters::Increment(&stats_.fetch_misses_);
+    bool ok = true;
+    if (persisted) {
+      auto start = std::chrono::steady_clock::now();
+      ok = disk_io_->ReadPage(page_id, FramePage(frame_id).data_);
+      stats_.read_latency_.Record(std::chrono::steady_clock::now() - start);
+    } else {
+      FramePage(frame_id).ResetMemory();  // 从未写回过的页，内容全为0
+    }
+    if (!FinishLoad(frame_id, page_id, ok)) {
+      return nullptr;
+    }
+    if (ring != nullptr) {
+      RecordScanFrame(ring, frame_id, page_id);
+    }
+    return &FramePage(frame_id);
+  }
 }
 
 auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
@@ -171,14 +1228,33 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   // 2.   If P exists, but has a non-zero pin-count, return false. Someone is using the page.
   // 3.   Otherwise, P can be deleted. Remove P from the page table, reset its metadata and return it to the free list.
   frame_id_t frame_id;
-  std::lock_guard<std::mutex> lock(latch_);  // 加锁
+  PageTableShard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> lock = LockLatch();  // 加锁，与GetFrame中从replacer取出页框互斥
+  std::unique_lock<std::mutex> shard_lock(shard.latch_);
 
-  if (page_table_.count(page_id) == 0) {
+  auto iter = shard.table_.find(page_id);
+  while (iter != shard.table_.end() && (frame_io_[iter->second] == FrameIOState::EVICTING ||
+                                        frame_io_[iter->second] == FrameIOState::FLUSHING)) {
+    // 被pin的页反正不能删除，不等它写回结束：调用者可能持有该页的锁，而写回线程可能在等这个锁
+    if (FramePage(iter->second).pin_count_ != 0) {
+      return false;
+    }
+    // 该页正在被写回，等待时不能持有latch_
+    lock.unlock();
+    shard.io_done_.wait(shard_lock);
+    shard_lock.unlock();
+    lock.lock();
+    shard_lock.lock();
+    iter = shard.table_.find(page_id);
+  }
+  if (iter == shard.table_.end()) {
+    shard.unpersisted_.erase(page_id);
+    BufferPoolCounters::Increment(&stats_.deleted_pages_);
     return true;
   }
-  frame_id = page_table_[page_id];
-  Page &delete_page = pages_[frame_id];
-  if (delete_page.pin_count_ != 0) {
+  frame_id = iter->second;
+  Page &delete_page = FramePage(frame_id);
+  if (delete_page.pin_count_ != 0 || !LockSwizzlePins(frame_id)) {  // 正在读入的页也处于pin状态
     return false;
   }
   // 不需要写回页，该页已删除
@@ -186,30 +1262,45 @@ auto BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) -> bool {
   //   disk_manager_->WritePage(page_id, delete_page.data_);
   // }
   // 从页表中删除该页，并将页框放回空闲列表
-  page_table_.erase(page_id);
+  InvalidateFrame(frame_id);
+  shard.table_.erase(iter);
+  shard.unpersisted_.erase(page_id);
   replacer_->Pin(frame_id);
-  free_list_.emplace_back(frame_id);
 
+  if (delete_page.is_dirty_) {
+    num_dirty_--;
+  }
   delete_page.page_id_ = INVALID_PAGE_ID;
   delete_page.pin_count_ = 0;
   delete_page.is_dirty_ = false;
+  frame_page_ids_[frame_id] = INVALID_PAGE_ID;
+  if (static_cast<size_t>(frame_id) >= pool_size_) {
+    RetireFrame(frame_id);
+  } else {
+    free_list_.emplace_back(frame_id);
+    num_free_frames_++;
+  }
   DeallocatePage(page_id);  // 调用DeallocatePage方法
+  BufferPoolCounters::Increment(&stats_.deleted_pages_);
   return true;
 }
 
 // 放回页
 auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) -> bool {
-  std::lock_guard<std::mutex> lock(latch_);  // 加锁
-  if (page_table_.count(page_id) == 0) {
+  PageTableShard &shard = GetShard(page_id);
+  std::lock_guard<std::mutex> lock(shard.latch_);  // 只需加分片锁
+  auto iter = shard.table_.find(page_id);
+  if (iter == shard.table_.end()) {
     return false;
   }
-  frame_id_t frame_id = page_table_[page_id];
-  Page &page = pages_[frame_id];
+  frame_id_t frame_id = iter->second;
+  Page &page = FramePage(frame_id);
   if (page.pin_count_ <= 0) {
     return false;
   }
-  if (is_dirty) {  // 不能直接赋值
+  if (is_dirty && !page.is_dirty_) {  // 不能直接赋值
     page.is_dirty_ = true;
+    num_dirty_++;
   }
   page.pin_count_--;
   if (page.pin_count_ == 0) {
@@ -219,8 +1310,7 @@ auto BufferPoolManagerInstance::UnpinPgImp(page_id_t page_id, bool is_dirty) ->
 }
 
 auto BufferPoolManagerInstance::AllocatePage() -> page_id_t {
-  const page_id_t next_page_id = next_page_id_;
-  next_page_id_ += num_instances_;
+  const page_id_t next_page_id = next_page_id_.fetch_add(num_instances_);  // NewPage不再持有latch_，需原子地分配
   ValidatePageId(next_page_id);
   return next_page_id;
 }
@@ -0,0 +1,142 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.cpp
+//
+// Identification: src/buffer/buffer_pool_stats.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_stats.h"
+
+#include <algorithm>
+
+namespace bustub {
+
+auto LatencyHistogramSnapshot::MeanMicros() const -> double {
+  return count_ == 0 ? 0 : static_cast<double>(total_ns_) / static_cast<double>(count_) / 1000;
+}
+
+auto LatencyHistogramSnapshot::PercentileMicros(double fraction) const -> uint64_t {
+  if (count_ == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(fraction * static_cast<double>(count_));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    seen += buckets_[i];
+    if (seen > rank) {
+      return uint64_t{1} << i;
+    }
+  }
+  return uint64_t{1} << (LATENCY_BUCKET_COUNT - 1);
+}
+
+auto LatencyHistogramSnapshot::operator+=(const LatencyHistogramSnapshot &other) -> LatencyHistogramSnapshot & {
+  for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  total_ns_ += other.total_ns_;
+  return *this;
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) {
+  auto nanos = static_cast<uint64_t>(std::max<int64_t>(0, latency.count()));
+  // 桶的下标是微秒数的二进制位数
+  uint64_t micros = nanos / 1000;
+  size_t bucket = 0;
+  while (micros != 0 && bucket < LATENCY_BUCKET_COUNT - 1) {
+    micros >>= 1;
+    bucket++;
+  }
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_ns_.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+auto LatencyHistogram::Snapshot() const -> LatencyHistogramSnapshot {
+  LatencyHistogramSnapshot snapshot;
+  for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+    snapshot.buckets_[i] = buckets_[i].load(std::memory_order_relaxed);
+  }
+  snapshot.count_ = count_.load(std::memory_order_relaxed);
+  snapshot.total_ns_ = total_ns_.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void LatencyHistogram::Reset() {
+  for (auto &bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  total_ns_.store(0, std::memory_order_relaxed);
+}
+
+auto StripedCounter::Load() const -> uint64_t {
+  uint64_t sum = 0;
+  for (const auto &stripe : stripes_) {
+    sum += stripe.value_.load(std::memory_order_relaxed);
+  }
+  return sum;
+}
+
+void StripedCounter::Reset() {
+  for (auto &stripe : stripes_) {
+    stripe.value_.store(0, std::memory_order_relaxed);
+  }
+}
+
+auto BufferPoolStats::HitRate() const -> double {
+  uint64_t fetches = fetch_hits_ + fetch_misses_;
+  return fetches == 0 ? 0 : static_cast<double>(fetch_hits_) / static_cast<double>(fetches);
+}
+
+auto BufferPoolStats::operator+=(const BufferPoolStats &other) -> BufferPoolStats & {
+  fetch_hits_ += other.fetch_hits_;
+  fetch_misses_ += other.fetch_misses_;
+  evictions_ += other.evictions_;
+  dirty_evictions_ += other.dirty_evictions_;
+  flushed_pages_ += other.flushed_pages_;
+  prefetched_pages_ += other.prefetched_pages_;
+  new_pages_ += other.new_pages_;
+  deleted_pages_ += other.deleted_pages_;
+  latch_waits_ += other.latch_waits_;
+  latch_wait_ns_ += other.latch_wait_ns_;
+  read_latency_ += other.read_latency_;
+  write_latency_ += other.write_latency_;
+  return *this;
+}
+
+auto BufferPoolCounters::Snapshot() const -> BufferPoolStats {
+  BufferPoolStats stats;
+  stats.fetch_hits_ = fetch_hits_.Load();
+  stats.fetch_misses_ = fetch_misses_.Load();
+  stats.evictions_ = evictions_.load(std::memory_order_relaxed);
+  stats.dirty_evictions_ = dirty_evictions_.load(std::memory_order_relaxed);
+  stats.flushed_pages_ = flushed_pages_.load(std::memory_order_relaxed);
+  stats.prefetched_pages_ = prefetched_pages_.load(std::memory_order_relaxed);
+  stats.new_pages_ = new_pages_.load(std::memory_order_relaxed);
+  stats.deleted_pages_ = deleted_pages_.load(std::memory_order_relaxed);
+  stats.latch_waits_ = latch_waits_.load(std::memory_order_relaxed);
+  stats.latch_wait_ns_ = latch_wait_ns_.load(std::memory_order_relaxed);
+  stats.read_latency_ = read_latency_.Snapshot();
+  stats.write_latency_ = write_latency_.Snapshot();
+  return stats;
+}
+
+void BufferPoolCounters::Reset() {
+  fetch_hits_.Reset();
+  fetch_misses_.Reset();
+  for (auto *counter : {&evictions_, &dirty_evictions_, &flushed_pages_, &prefetched_pages_, &new_pages_,
+                        &deleted_pages_, &latch_waits_, &latch_wait_ns_}) {
+    counter->store(0, std::memory_order_relaxed);
+  }
+  read_latency_.Reset();
+  write_latency_.Reset();
+}
+
+}  // namespace bustub
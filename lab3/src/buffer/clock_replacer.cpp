@@ -0,0 +1,89 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// clock_replacer.cpp
+//
+// Identification: src/buffer/clock_replacer.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/clock_replacer.h"
+
+#include "common/macros.h"
+
+namespace bustub {
+
+ClockReplacer::ClockReplacer(size_t num_pages) : num_pages_(num_pages), frames_(num_pages) {}
+
+ClockReplacer::~ClockReplacer() = default;
+
+auto ClockReplacer::Victim(frame_id_t *frame_id) -> bool {
+  std::lock_guard<std::mutex> lock(hand_mutex_);
+  while (size_.load() > 0) {
+    size_t pos = clock_hand_;
+    clock_hand_ = (clock_hand_ + 1) % num_pages_;
+
+    uint8_t state = frames_[pos].load();
+    if ((state & EVICTABLE) == 0) {
+      continue;
+    }
+    if ((state & REFERENCED) != 0) {  // 给第二次机会，清除引用位
+      frames_[pos].fetch_and(static_cast<uint8_t>(~REFERENCED));
+      continue;
+    }
+    // 与并发的Pin竞争，CAS失败说明该页框刚被pin或重新引用
+    if (frames_[pos].compare_exchange_strong(state, 0)) {
+      size_--;
+      *frame_id = static_cast<frame_id_t>(pos);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ClockReplacer::Pin(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  if ((frames_[frame_id].exchange(0) & EVICTABLE) != 0) {
+    size_--;
+  }
+}
+
+void ClockReplacer::Unpin(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  // 先加计数再发布可淘汰位，并发的Victim/Pin清除该位后再减，size_不会小于0
+  size_++;
+  // 对同一个元素调用两次unpin函数，第二次只会重新设置引用位，撤回多加的计数
+  if ((frames_[frame_id].fetch_or(EVICTABLE | REFERENCED) & EVICTABLE) != 0) {
+    size_--;
+  }
+}
+
+void ClockReplacer::RecordReference(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  // 只给可淘汰的页框置引用位，不能让被pin的页框带着引用位；引用位已置时不写，避免缓存行来回传递
+  uint8_t state = frames_[frame_id].load(std::memory_order_relaxed);
+  if (state == EVICTABLE) {
+    // 失败说明页框刚被pin、被淘汰或已置引用位，都不需要再置
+    frames_[frame_id].compare_exchange_strong(state, static_cast<uint8_t>(EVICTABLE | REFERENCED));
+  }
+}
+
+auto ClockReplacer::Size() -> size_t { return size_.load(); }
+
+void ClockReplacer::PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) {
+  std::lock_guard<std::mutex> lock(hand_mutex_);
+  // 从时钟指针开始转一圈，先取引用位已清除的页框，不够时再取带引用位的页框
+  for (uint8_t want : {EVICTABLE, static_cast<uint8_t>(EVICTABLE | REFERENCED)}) {
+    for (size_t i = 0; i < num_pages_ && frames->size() < max_frames; i++) {
+      size_t pos = (clock_hand_ + i) % num_pages_;
+      if (frames_[pos].load() == want) {
+        frames->push_back(static_cast<frame_id_t>(pos));
+      }
+    }
+  }
+}
+
+}  // namespace bustub
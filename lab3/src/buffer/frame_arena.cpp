@@ -0,0 +1,123 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_arena.cpp
+//
+// Identification: src/buffer/frame_arena.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/frame_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+#include "common/logger.h"
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bustub {
+
+namespace {
+
+#ifdef __linux__
+/** Size of a huge page on x86-64 and the default on arm64. */
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+#endif
+
+auto RoundUp(size_t size, size_t alignment) -> size_t { return (size + alignment - 1) / alignment * alignment; }
+
+}  // namespace
+
+FrameArena::FrameArena(size_t frame_count, const FrameArenaOptions &options)
+    : frame_count_(frame_count),
+      capacity_(std::max(frame_count, options.max_frame_count_)),
+      stride_(options.aligned_frames_ ? RoundUp(sizeof(Page), FRAME_ALIGNMENT) : sizeof(Page)) {
+  // 按最大容量预留地址空间，未使用的部分不占物理内存
+  size_t size = capacity_ * stride_;
+#ifdef __linux__
+  void *memory = MAP_FAILED;
+  if (options.huge_pages_) {
+    // 优先使用预留的大页，没有预留时退回普通映射并建议内核使用透明大页
+    mapping_size_ = RoundUp(size, HUGE_PAGE_SIZE);
+    memory = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    huge_tlb_ = memory != MAP_FAILED;
+  }
+  if (memory == MAP_FAILED) {
+    mapping_size_ = RoundUp(size, static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+    memory = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    BUSTUB_ASSERT(memory != MAP_FAILED, "failed to allocate the buffer pool frames");
+    if (options.huge_pages_ && madvise(memory, mapping_size_, MADV_HUGEPAGE) != 0) {
+      LOG_DEBUG("transparent huge pages are not available for the buffer pool");
+    }
+  }
+  if (options.numa_node_ >= 0) {
+    // 必须在第一次访问之前绑定，页面在构造Page时才真正分配在指定节点上
+    unsigned long node_mask[16] = {};  // NOLINT
+    constexpr size_t max_node = sizeof(node_mask) * 8;
+    if (static_cast<size_t>(options.numa_node_) < max_node) {
+      node_mask[options.numa_node_ / 64] = 1UL << (options.numa_node_ % 64);
+      if (syscall(__NR_mbind, memory, mapping_size_, MPOL_BIND, node_mask, max_node, 0) != 0) {
+        LOG_DEBUG("failed to bind the buffer pool frames to NUMA node %d", options.numa_node_);
+      }
+    }
+  }
+  memory_ = static_cast<char *>(memory);
+#else
+  memory_ = static_cast<char *>(::operator new(size, std::align_val_t(FRAME_ALIGNMENT)));
+#endif
+  for (size_t i = 0; i < frame_count_; i++) {
+    new (&Frame(i)) Page();
+  }
+  // 映射按页对齐、步长是对齐的整数倍，页框的数据（Page的第一个成员）都对齐
+  BUSTUB_ASSERT(!options.aligned_frames_ || frame_count_ == 0 ||
+                    reinterpret_cast<uintptr_t>(Frame(0).GetData()) % FRAME_ALIGNMENT == 0,
+                "Page data must be the first member of Page for aligned frames");
+}
+
+void FrameArena::Resize(size_t frame_count) {
+  BUSTUB_ASSERT(frame_count <= capacity_, "frame arena cannot grow beyond its capacity");
+  for (size_t i = frame_count_; i < frame_count; i++) {
+    new (&Frame(i)) Page();
+  }
+  for (size_t i = frame_count; i < frame_count_; i++) {
+    Frame(i).~Page();
+  }
+  if (frame_count < frame_count_) {
+    ReleaseTail(frame_count);
+  }
+  frame_count_ = frame_count;
+}
+
+void FrameArena::ReleaseTail(size_t frame_count) {
+#ifdef __linux__
+  // 只能释放完全落在被删除页框内的(大)页，之后再次访问时内核重新分配清零的内存
+  size_t page_size = huge_tlb_ ? HUGE_PAGE_SIZE : static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t begin = RoundUp(frame_count * stride_, page_size);
+  if (begin < mapping_size_ && madvise(memory_ + begin, mapping_size_ - begin, MADV_DONTNEED) != 0) {
+    LOG_DEBUG("failed to release the memory of removed buffer pool frames");
+  }
+#endif
+}
+
+FrameArena::~FrameArena() {
+  for (size_t i = 0; i < frame_count_; i++) {
+    Frame(i).~Page();
+  }
+#ifdef __linux__
+  munmap(memory_, mapping_size_);
+#else
+  ::operator delete(memory_, std::align_val_t(FRAME_ALIGNMENT));
+#endif
+}
+
+}  // namespace bustub
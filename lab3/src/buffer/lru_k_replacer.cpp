@@ -0,0 +1,128 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.cpp
+//
+// Identification: src/buffer/lru_k_replacer.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/lru_k_replacer.h"
+
+#include "common/macros.h"
+
+namespace bustub {
+
+LRUKReplacer::LRUKReplacer(size_t num_pages, size_t k)
+    : num_pages_(num_pages),
+      k_(k),
+      history_(num_pages * k),
+      access_count_(num_pages),
+      history_head_(num_pages),
+      evictable_(num_pages),
+      victimized_(num_pages) {
+  BUSTUB_ASSERT(k > 0, "k of LRU-K must be positive");
+}
+
+LRUKReplacer::~LRUKReplacer() = default;
+
+auto LRUKReplacer::Victim(frame_id_t *frame_id) -> bool {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (eviction_order_.empty()) {
+    return false;
+  }
+  // 访问历史留到页框换页时再由ResetHistory清空，调用者放弃该页框时热页不会丢失历史
+  frame_id_t victim = std::get<2>(*eviction_order_.begin());
+  eviction_order_.erase(eviction_order_.begin());
+  evictable_[victim] = false;
+  victimized_[victim] = true;
+  size_--;
+  *frame_id = victim;
+  return true;
+}
+
+void LRUKReplacer::Pin(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  std::lock_guard<std::mutex> lock(mutex_);
+  victimized_[frame_id] = false;
+  if (evictable_[frame_id]) {
+    eviction_order_.erase(GetEvictionKey(frame_id));
+    evictable_[frame_id] = false;
+    size_--;
+  }
+}
+
+void LRUKReplacer::Unpin(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  std::lock_guard<std::mutex> lock(mutex_);
+  // 对同一个元素调用两次unpin函数，第二次无效
+  if (!evictable_[frame_id]) {
+    if (!victimized_[frame_id]) {
+      RecordAccess(frame_id);
+    }
+    victimized_[frame_id] = false;
+    evictable_[frame_id] = true;
+    eviction_order_.insert(GetEvictionKey(frame_id));
+    size_++;
+  }
+}
+
+void LRUKReplacer::RecordReference(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (evictable_[frame_id]) {
+    eviction_order_.erase(GetEvictionKey(frame_id));
+    RecordAccess(frame_id);
+    eviction_order_.insert(GetEvictionKey(frame_id));
+  }
+}
+
+auto LRUKReplacer::Size() -> size_t {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+void LRUKReplacer::PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto iter = eviction_order_.begin(); iter != eviction_order_.end() && max_frames > 0; ++iter, max_frames--) {
+    frames->push_back(std::get<2>(*iter));
+  }
+}
+
+void LRUKReplacer::ResetHistory(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (evictable_[frame_id]) {
+    eviction_order_.erase(GetEvictionKey(frame_id));
+  }
+  access_count_[frame_id] = 0;
+  history_head_[frame_id] = 0;
+  victimized_[frame_id] = false;
+  if (evictable_[frame_id]) {
+    eviction_order_.insert(GetEvictionKey(frame_id));
+  }
+}
+
+auto LRUKReplacer::GetEvictionKey(frame_id_t frame_id) const -> EvictionKey {
+  // 环形缓冲区写满时，下一个写入位置即为第k近的访问；未满时取最早的一次访问
+  // 同为+inf或同为有限距离时，时间戳越早距离越大
+  if (access_count_[frame_id] < k_) {
+    // 从未被访问过的页框没有时间戳，排在所有+inf页框之前
+    size_t timestamp = access_count_[frame_id] == 0 ? 0 : history_[frame_id * k_];
+    return {false, timestamp, frame_id};
+  }
+  return {true, history_[frame_id * k_ + history_head_[frame_id]], frame_id};
+}
+
+void LRUKReplacer::RecordAccess(frame_id_t frame_id) {
+  history_[frame_id * k_ + history_head_[frame_id]] = current_timestamp_++;
+  history_head_[frame_id] = (history_head_[frame_id] + 1) % k_;
+  if (access_count_[frame_id] < k_) {
+    access_count_[frame_id]++;
+  }
+}
+
+}  // namespace bustub
@@ -50,9 +50,25 @@ void LRUReplacer::Unpin(frame_id_t frame_id) {
   }
 }
 
+void LRUReplacer::RecordReference(frame_id_t frame_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = speed_map_.find(frame_id);
+  if (iter != speed_map_.end()) {
+    lru_list_.splice(lru_list_.begin(), lru_list_, iter->second);  // 迭代器在splice后仍然有效
+  }
+}
+
 auto LRUReplacer::Size() -> size_t {
   std::lock_guard<std::mutex> lock(mutex_);
   return lru_list_.size();
 }
 
+void LRUReplacer::PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // 从LRU列表末尾向前取
+  for (auto iter = lru_list_.rbegin(); iter != lru_list_.rend() && frames->size() < max_frames; ++iter) {
+    frames->push_back(*iter);
+  }
+}
+
 }  // namespace bustub
@@ -0,0 +1,223 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// partitioned_lru_replacer.cpp
+//
+// Identification: src/buffer/partitioned_lru_replacer.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/partitioned_lru_replacer.h"
+
+#include <algorithm>
+
+#include "common/macros.h"
+
+namespace bustub {
+
+PartitionedLRUReplacer::PartitionedLRUReplacer(size_t num_pages, size_t num_partitions)
+    : num_pages_(num_pages),
+      partitions_(std::max<size_t>(num_partitions, 1)),
+      unpin_buffers_(UNPIN_BUFFER_COUNT),
+      prev_(num_pages, NO_FRAME),
+      next_(num_pages, NO_FRAME),
+      stamps_(num_pages, 0),
+      listed_(num_pages),
+      pin_seqs_(num_pages) {
+  for (auto &buffer : unpin_buffers_) {
+    buffer.entries_.reserve(UNPIN_BATCH_SIZE);
+  }
+}
+
+PartitionedLRUReplacer::~PartitionedLRUReplacer() = default;
+
+auto PartitionedLRUReplacer::Victim(frame_id_t *frame_id) -> bool {
+  // 第一轮只看各分区，都为空时再把各线程缓冲的unpin放入分区后重试
+  for (int round = 0; round < 2; round++) {
+    while (true) {
+      // 各分区队尾中最早放回的即为近似的全局LRU页框，不加锁读取时间戳
+      Partition *oldest = nullptr;
+      uint64_t oldest_stamp = UINT64_MAX;
+      for (auto &partition : partitions_) {
+        uint64_t stamp = partition.oldest_.load(std::memory_order_relaxed);
+        if (stamp < oldest_stamp) {
+          oldest_stamp = stamp;
+          oldest = &partition;
+        }
+      }
+      if (oldest == nullptr) {
+        break;
+      }
+      std::lock_guard<std::mutex> lock(oldest->latch_);
+      if (oldest->tail_ == NO_FRAME) {
+        continue;  // 该分区刚被其他线程取空
+      }
+      *frame_id = oldest->tail_;
+      Remove(oldest, *frame_id);
+      listed_[*frame_id].store(false, std::memory_order_relaxed);
+      return true;
+    }
+    if (round == 0) {
+      DrainUnpinBuffers();
+    }
+  }
+  return false;
+}
+
+void PartitionedLRUReplacer::Pin(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  // 先使缓冲中的unpin失效，再检查是否已在分区中；与FlushUnpins的先置listed_再检查序号对应，不会漏掉
+  pin_seqs_[frame_id].fetch_add(1);
+  if (!listed_[frame_id].load()) {
+    return;  // 命中路径上被pin的页框大多不在replacer中，不需要加锁
+  }
+  Partition &partition = GetPartition(frame_id);
+  std::lock_guard<std::mutex> lock(partition.latch_);
+  if (listed_[frame_id].load(std::memory_order_relaxed)) {
+    Remove(&partition, frame_id);
+    listed_[frame_id].store(false, std::memory_order_relaxed);
+  }
+}
+
+void PartitionedLRUReplacer::Unpin(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  uint32_t seq = pin_seqs_[frame_id].load();
+  UnpinBuffer &buffer = ThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.latch_);
+  // 同一页框在本线程缓冲中只留最近的一次放回，重复的unpin不会使Size偏大
+  auto iter = std::find_if(buffer.entries_.begin(), buffer.entries_.end(),
+                           [frame_id](const auto &entry) { return entry.first == frame_id; });
+  if (iter != buffer.entries_.end()) {
+    buffer.entries_.erase(iter);
+  }
+  buffer.entries_.emplace_back(frame_id, seq);
+  // 放入分区时仍持有缓冲的锁，Victim清空缓冲时不会漏掉正在放入的这一批
+  if (buffer.entries_.size() >= UNPIN_BATCH_SIZE) {
+    FlushUnpins(&buffer.entries_);
+  }
+  buffer.size_.store(buffer.entries_.size(), std::memory_order_relaxed);
+}
+
+void PartitionedLRUReplacer::RecordReference(frame_id_t frame_id) {
+  BUSTUB_ASSERT(static_cast<size_t>(frame_id) < num_pages_, "frame id out of range");
+  if (!listed_[frame_id].load()) {
+    return;  // 被pin或放回仍在缓冲中，缓冲中的放回本就会被当作最近使用
+  }
+  Partition &partition = GetPartition(frame_id);
+  std::lock_guard<std::mutex> lock(partition.latch_);
+  if (listed_[frame_id].load(std::memory_order_relaxed) && partition.head_ != frame_id) {
+    // listed_保持为true，不加锁检查listed_的Pin不会因此漏掉移除
+    Remove(&partition, frame_id);
+    PushFront(&partition, frame_id, clock_.fetch_add(1, std::memory_order_relaxed));
+  }
+}
+
+auto PartitionedLRUReplacer::Size() -> size_t {
+  // 不清空各线程的缓冲，只读计数；缓冲中已被重新pin的页框也计入，只会偏大
+  size_t size = 0;
+  for (auto &partition : partitions_) {
+    size += partition.size_.load(std::memory_order_relaxed);
+  }
+  for (auto &buffer : unpin_buffers_) {
+    size += buffer.size_.load(std::memory_order_relaxed);
+  }
+  return size;
+}
+
+void PartitionedLRUReplacer::PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) {
+  DrainUnpinBuffers();
+  // 从每个分区队尾取至多max_frames个，再按时间戳归并
+  std::vector<std::pair<uint64_t, frame_id_t>> candidates;
+  for (auto &partition : partitions_) {
+    std::lock_guard<std::mutex> lock(partition.latch_);
+    size_t taken = 0;
+    for (frame_id_t frame = partition.tail_; frame != NO_FRAME && taken < max_frames; frame = prev_[frame]) {
+      candidates.emplace_back(stamps_[frame], frame);
+      taken++;
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  for (size_t i = 0; i < candidates.size() && frames->size() < max_frames; i++) {
+    frames->push_back(candidates[i].second);
+  }
+}
+
+auto PartitionedLRUReplacer::ThreadBuffer() -> UnpinBuffer & {
+  static std::atomic<size_t> next_thread_index{0};
+  thread_local size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+  return unpin_buffers_[thread_index % UNPIN_BUFFER_COUNT];
+}
+
+void PartitionedLRUReplacer::FlushUnpins(std::vector<std::pair<frame_id_t, uint32_t>> *entries) {
+  // 一批共用一个时间戳，同一批内按放回顺序排列
+  uint64_t stamp = clock_.fetch_add(1, std::memory_order_relaxed);
+  size_t num_partitions = partitions_.size();
+  std::stable_sort(entries->begin(), entries->end(), [num_partitions](const auto &a, const auto &b) {
+    return a.first % num_partitions < b.first % num_partitions;
+  });
+  size_t i = 0;
+  while (i < entries->size()) {
+    Partition &partition = GetPartition((*entries)[i].first);
+    std::lock_guard<std::mutex> lock(partition.latch_);
+    for (; i < entries->size() && &GetPartition((*entries)[i].first) == &partition; i++) {
+      auto [frame_id, seq] = (*entries)[i];
+      if (listed_[frame_id].load(std::memory_order_relaxed)) {
+        continue;  // 对同一个元素调用两次unpin函数，第二次无效
+      }
+      // 先置listed_再检查序号：若其后有Pin，要么这里看到序号变了，要么Pin看到listed_后加锁移除
+      listed_[frame_id].store(true);
+      if (pin_seqs_[frame_id].load() != seq) {
+        listed_[frame_id].store(false);
+        continue;
+      }
+      PushFront(&partition, frame_id, stamp);
+    }
+  }
+  entries->clear();
+}
+
+void PartitionedLRUReplacer::DrainUnpinBuffers() {
+  for (auto &buffer : unpin_buffers_) {
+    std::lock_guard<std::mutex> lock(buffer.latch_);
+    if (!buffer.entries_.empty()) {
+      FlushUnpins(&buffer.entries_);
+      buffer.size_.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+void PartitionedLRUReplacer::PushFront(Partition *partition, frame_id_t frame_id, uint64_t stamp) {
+  stamps_[frame_id] = stamp;
+  prev_[frame_id] = NO_FRAME;
+  next_[frame_id] = partition->head_;
+  if (partition->head_ != NO_FRAME) {
+    prev_[partition->head_] = frame_id;
+  } else {
+    partition->tail_ = frame_id;
+    partition->oldest_.store(stamp, std::memory_order_relaxed);
+  }
+  partition->head_ = frame_id;
+  partition->size_++;
+}
+
+void PartitionedLRUReplacer::Remove(Partition *partition, frame_id_t frame_id) {
+  frame_id_t prev = prev_[frame_id];
+  frame_id_t next = next_[frame_id];
+  if (prev != NO_FRAME) {
+    next_[prev] = next;
+  } else {
+    partition->head_ = next;
+  }
+  if (next != NO_FRAME) {
+    prev_[next] = prev;
+  } else {
+    partition->tail_ = prev;
+    partition->oldest_.store(prev == NO_FRAME ? UINT64_MAX : stamps_[prev], std::memory_order_relaxed);
+  }
+  partition->size_--;
+}
+
+}  // namespace bustub
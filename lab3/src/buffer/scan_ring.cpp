@@ -0,0 +1,19 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// scan_ring.cpp
+//
+// Identification: src/buffer/scan_ring.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/scan_ring.h"
+
+namespace bustub {
+
+thread_local ScanRing *ScanRing::current_ = nullptr;
+
+}  // namespace bustub
@@ -10,6 +10,8 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
+#include <array>
 #include <iostream>
 #include <string>
 #include <utility>
@@ -25,25 +27,40 @@ namespace bustub {
 template <typename KeyType, typename ValueType, typename KeyComparator>
 HASH_TABLE_TYPE::ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
                                      const KeyComparator &comparator, HashFunction<KeyType> hash_fn)
-    : buffer_pool_manager_(buffer_pool_manager), comparator_(comparator), hash_fn_(std::move(hash_fn)) {
+    : buffer_pool_manager_(buffer_pool_manager),
+      prefetcher_(PagePrefetcher::FromBufferPool(buffer_pool_manager)),
+      optimistic_reader_(OptimisticPageReader::FromBufferPool(buffer_pool_manager)),
+      swizzler_(PageSwizzler::FromBufferPool(buffer_pool_manager)),
+      comparator_(comparator),
+      hash_fn_(std::move(hash_fn)) {
   //  implement me!
   /*
-  将目录页永久地驻留在缓存中，但未在析构函数中unpin，实际上是存在问题的
-  但我觉得每个操作前fetch目录，操作完成后再unpin太难看了，并且效率不高
-  但由于测试方法各对象的析构顺序为:
+  目录页不再永久驻留在缓存中：测试中各对象的析构顺序为
   delete disk_manager;
   delete bpm;
   delete hash table
-  故无法在hash table或BufferPoolManager的析构函数中写入缓存页
-  我之前版本的代码是每个操作前fetch目录，操作完成后再unpin
+  无法在析构函数中unpin，故每个操作都pin一次目录页，由page guard在操作结束时放回
+  支持swizzle的缓冲池中，目录页一直驻留时pin它只是一次原子加，不查页表
   */
-  dir_page_ = CreateDirectoryPage(&directory_page_id_);  // 创建目录页
+  BasicPageGuard dir_guard = CreateDirectoryPage(&directory_page_id_);  // 创建目录页
 
   page_id_t bucket_page_id;
-  buffer_pool_manager_->NewPage(&bucket_page_id, nullptr);  // 申请第一个桶的页
-  dir_page_->SetBucketPageId(0, bucket_page_id);
+  BasicPageGuard bucket_guard = CreateBucketPage(&bucket_page_id);  // 申请第一个桶的页
+  auto *dir_page = dir_guard.AsMut<HashTableDirectoryPage>();
+  dir_page->SetPageId(directory_page_id_);
+  dir_page->SetBucketPageId(0, bucket_page_id);
+  bucket_refs_.reserve(DIRECTORY_MAX_SEGMENTS);  // 预留足够的空间，目录扩展时不会重新分配
+  bucket_refs_.push_back(std::make_unique<BucketRefs>());
+}
 
-  buffer_pool_manager_->UnpinPage(bucket_page_id, false, nullptr);  // 放回桶页
+template <typename KeyType, typename ValueType, typename KeyComparator>
+HASH_TABLE_TYPE::~ExtendibleHashTable() {
+  // 只有并发合并时删除失败才会留下桶页，没有遗留时不访问缓冲池，缓冲池先于哈希表析构也没有问题
+  for (page_id_t page_id : retired_pages_) {
+    if (!buffer_pool_manager_->DeletePage(page_id, nullptr)) {
+      LOG_DEBUG("retired bucket page %d is still pinned, not deleted", page_id);
+    }
+  }
 }
 
 /*****************************************************************************
@@ -62,29 +79,25 @@ auto HASH_TABLE_TYPE::Hash(KeyType key) -> uint32_t {
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-inline auto HASH_TABLE_TYPE::KeyToDirectoryIndex(KeyType key, HashTableDirectoryPage *dir_page_) -> uint32_t {
-  uint32_t index = Hash(key) & dir_page_->GetGlobalDepthMask();
+inline auto HASH_TABLE_TYPE::KeyToDirectoryIndex(KeyType key, HashTableDirectory *dir) -> uint32_t {
+  uint32_t index = Hash(key) & dir->GetGlobalDepthMask();
   return index;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-inline auto HASH_TABLE_TYPE::KeyToPageId(KeyType key, HashTableDirectoryPage *dir_page_) -> uint32_t {
-  uint32_t index = KeyToDirectoryIndex(key, dir_page_);
-  page_id_t page_id = dir_page_->GetBucketPageId(index);
+inline auto HASH_TABLE_TYPE::KeyToPageId(KeyType key, HashTableDirectory *dir) -> uint32_t {
+  uint32_t index = KeyToDirectoryIndex(key, dir);
+  page_id_t page_id = dir->GetBucketPageId(index);
   return page_id;
 }
 template <typename KeyType, typename ValueType, typename KeyComparator>
-auto HASH_TABLE_TYPE::CreateDirectoryPage(page_id_t *bucket_page_id) -> HashTableDirectoryPage * {
-  auto new_dir_page = reinterpret_cast<HashTableDirectoryPage *>(
-      buffer_pool_manager_->NewPage(&directory_page_id_, nullptr)->GetData());  // 创建目录页
-  return new_dir_page;
+auto HASH_TABLE_TYPE::CreateDirectoryPage(page_id_t *dir_page_id) -> BasicPageGuard {
+  return NewPageGuarded(buffer_pool_manager_, dir_page_id);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-auto HASH_TABLE_TYPE::CreateBucketPage(page_id_t *bucket_page_id) -> HASH_TABLE_BUCKET_TYPE * {
-  auto *new_bucket_page =
-      reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(buffer_pool_manager_->NewPage(bucket_page_id, nullptr)->GetData());
-  return new_bucket_page;
+auto HASH_TABLE_TYPE::CreateBucketPage(page_id_t *bucket_page_id) -> BasicPageGuard {
+  return NewPageGuarded(buffer_pool_manager_, bucket_page_id);
 }
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_TYPE::FetchDirectoryPage() -> HashTableDirectoryPage * {
@@ -94,10 +107,83 @@ auto HASH_TABLE_TYPE::FetchDirectoryPage() -> HashTableDirectoryPage * {
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-auto HASH_TABLE_TYPE::FetchBucketPage(page_id_t bucket_page_id) -> HASH_TABLE_BUCKET_TYPE * {
-  auto bucket_page =
-      reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(buffer_pool_manager_->FetchPage(bucket_page_id, nullptr)->GetData());
-  return bucket_page;
+auto HASH_TABLE_TYPE::FetchBucketPage(page_id_t bucket_page_id) -> BasicPageGuard {
+  return FetchPageBasic(buffer_pool_manager_, bucket_page_id);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_TYPE::PinDirectoryPage() -> BasicPageGuard {
+  return PinPageThroughRef(buffer_pool_manager_, swizzler_, &dir_ref_, directory_page_id_);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_TYPE::Directory(HashTableDirectoryPage *dir_page) -> HashTableDirectory {
+  return HashTableDirectory(buffer_pool_manager_, swizzler_, segment_refs_.data(), dir_page);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_TYPE::PinBucketPage(uint32_t index, page_id_t bucket_page_id) -> BasicPageGuard {
+  std::atomic<Page *> *ref = &(*bucket_refs_[index / DIRECTORY_ARRAY_SIZE])[index % DIRECTORY_ARRAY_SIZE];
+  return PinPageThroughRef(buffer_pool_manager_, swizzler_, ref, bucket_page_id);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_TYPE::OptimisticGetValue(const KeyType &key, uint32_t hash, std::vector<ValueType> *result,
+                                         bool *found) -> bool {
+  if (optimistic_reader_ == nullptr) {
+    return false;
+  }
+  size_t result_size = result->size();
+  OptimisticRead dir_read;
+  OptimisticRead segment_read;
+  OptimisticRead bucket_read;
+  for (int attempt = 0; attempt < OPTIMISTIC_READ_ATTEMPTS; attempt++) {
+    if (!optimistic_reader_->TryOptimisticRead(directory_page_id_, &dir_read)) {
+      return false;
+    }
+    // 读到的内容可能被并发修改，只用来计算下标并做越界检查，由目录页的版本判断是否有效
+    // 目录的所有修改（包括段页）都在持有目录页写锁并标记了BeginPageWrite期间进行，校验目录页就覆盖了段页
+    auto *root = reinterpret_cast<HashTableDirectoryPage *>(const_cast<char *>(dir_read.GetData()));
+    uint32_t global_depth = root->GetGlobalDepth();
+    if (global_depth > DIRECTORY_MAX_DEPTH) {
+      continue;
+    }
+    // 掩码由检查过的局部副本计算，不能再次读取页框中的全局深度
+    uint32_t index = hash & ((1U << global_depth) - 1);
+    uint32_t segment_idx = index / DIRECTORY_ARRAY_SIZE;
+    page_id_t bucket_page_id;
+    if (segment_idx == 0) {
+      bucket_page_id = root->GetBucketPageId(index);
+    } else {
+      if (segment_idx > root->GetNumSegmentPages()) {
+        continue;  // 段数与深度不一致，读到的是未校验的内容
+      }
+      if (!optimistic_reader_->TryOptimisticRead(root->GetSegmentPageId(segment_idx), &segment_read)) {
+        return false;
+      }
+      auto *segment = reinterpret_cast<HashTableDirectoryPage *>(const_cast<char *>(segment_read.GetData()));
+      bucket_page_id = segment->GetBucketPageId(index % DIRECTORY_ARRAY_SIZE);
+      if (!segment_read.Validate()) {
+        continue;  // 段页所在的页框被换成了其他页
+      }
+    }
+    if (!dir_read.Validate()) {
+      continue;
+    }
+    if (!optimistic_reader_->TryOptimisticRead(bucket_page_id, &bucket_read)) {
+      return false;
+    }
+    // 桶页的遍历次数由桶的槽数限定，读到被并发修改的内容也不会越界，校验失败时丢弃结果
+    auto *bucket_page = reinterpret_cast<HASH_TABLE_BUCKET_TYPE *>(const_cast<char *>(bucket_read.GetData()));
+    bool ret = bucket_page->GetValue(key, comparator_, result, hash);
+    // 读桶期间目录也没有变化，该桶在读取时仍是该键所在的桶（分裂先改目录再迁移元素）
+    if (bucket_read.Validate() && dir_read.Validate()) {
+      *found = ret;
+      return true;
+    }
+    result->resize(result_size);
+  }
+  return false;
 }
 
 /*****************************************************************************
@@ -105,17 +191,67 @@ auto HASH_TABLE_TYPE::FetchBucketPage(page_id_t bucket_page_id) -> HASH_TABLE_BU
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_TYPE::GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) -> bool {
-  table_latch_.RLock();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page_);
-  auto *bucket_page = FetchBucketPage(bucket_page_id);
+  bool found;
+  uint32_t hash = Hash(key);  // 只计算一次，用于目录下标和桶中的指纹
+  // 热点的目录页与桶页一般都在缓冲池中，先不pin不加锁地乐观读，查找不写任何共享的缓存行，失败时再正常读取
+  if (OptimisticGetValue(key, hash, result, &found)) {
+    return found;
+  }
+  ReadPageGuard dir_guard = PinDirectoryPage().UpgradeRead();
+  if (!dir_guard.IsValid()) {
+    return false;  // 缓冲池中所有页都被pin住，无法读入目录页
+  }
+  HashTableDirectory dir = Directory(dir_guard.As<HashTableDirectoryPage>());
+  uint32_t index = hash & dir.GetGlobalDepthMask();
+  ReadPageGuard bucket_guard = PinBucketPage(index, dir.GetBucketPageId(index)).UpgradeRead();  // 读取桶页内容前加页的读锁
+  dir.Drop();
+  dir_guard.Drop();  // 已持有桶的锁，分裂与合并无法再修改该桶，可以放开目录
+  if (!bucket_guard.IsValid()) {
+    return false;
+  }
+  return bucket_guard.As<HASH_TABLE_BUCKET_TYPE>()->GetValue(key, comparator_, result, hash);
+}
 
-  reinterpret_cast<Page *>(bucket_page)->RLatch();
-  bool ret = bucket_page->GetValue(key, comparator_, result);  // 读取桶页内容前加页的读锁
-  reinterpret_cast<Page *>(bucket_page)->RUnlatch();
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_TYPE::GetValues(Transaction *transaction, const std::vector<KeyType> &keys,
+                                std::vector<std::vector<ValueType>> *results) -> size_t {
+  PrefetchBuckets(keys);
+  results->assign(keys.size(), {});
+  size_t found = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (GetValue(transaction, keys[i], &(*results)[i])) {
+      found++;
+    }
+  }
+  return found;
+}
 
-  buffer_pool_manager_->UnpinPage(bucket_page_id, false, nullptr);
-  table_latch_.RUnlock();
-  return ret;
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::PrefetchBuckets(const std::vector<KeyType> &keys) {
+  if (prefetcher_ == nullptr || keys.size() < 2) {
+    return;  // 只查一个键时预取无法与其他读盘重叠
+  }
+  std::vector<page_id_t> bucket_page_ids;
+  bucket_page_ids.reserve(keys.size());
+  {
+    ReadPageGuard dir_guard = PinDirectoryPage().UpgradeRead();
+    if (!dir_guard.IsValid()) {
+      return;
+    }
+    HashTableDirectory dir = Directory(dir_guard.As<HashTableDirectoryPage>());
+    for (const auto &key : keys) {
+      bucket_page_ids.push_back(KeyToPageId(key, &dir));
+    }
+  }
+  // 预取只是提示，之后各次查找仍经过目录；只预取不在缓冲池中的桶，不占用预取队列
+  std::sort(bucket_page_ids.begin(), bucket_page_ids.end());
+  bucket_page_ids.erase(std::unique(bucket_page_ids.begin(), bucket_page_ids.end()), bucket_page_ids.end());
+  OptimisticRead read;
+  for (page_id_t bucket_page_id : bucket_page_ids) {
+    if (optimistic_reader_ == nullptr || !optimistic_reader_->TryOptimisticRead(bucket_page_id, &read)) {
+      prefetcher_->PrefetchPage(bucket_page_id);
+    }
+  }
 }
 
 /*****************************************************************************
@@ -123,120 +259,175 @@ auto HASH_TABLE_TYPE::GetValue(Transaction *transaction, const KeyType &key, std
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_TYPE::Insert(Transaction *transaction, const KeyType &key, const ValueType &value) -> bool {
-  table_latch_.RLock();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page_);
-  auto *bucket_page = FetchBucketPage(bucket_page_id);
-
-  reinterpret_cast<Page *>(bucket_page)->WLatch();
-  bool ret = bucket_page->Insert(key, value, comparator_);
-  reinterpret_cast<Page *>(bucket_page)->WUnlatch();
-
-  buffer_pool_manager_->UnpinPage(bucket_page_id, true, nullptr);
-  table_latch_.RUnlock();
-  if (!ret && bucket_page->IsFull()) {  // 该桶已满，插入失败
-    ret = SplitInsert(transaction, key, value);
+  ReadPageGuard dir_guard = PinDirectoryPage().UpgradeRead();
+  if (!dir_guard.IsValid()) {
+    return false;
+  }
+  HashTableDirectory dir = Directory(dir_guard.As<HashTableDirectoryPage>());
+  uint32_t hash = Hash(key);
+  uint32_t index = hash & dir.GetGlobalDepthMask();
+  WritePageGuard bucket_guard = PinBucketPage(index, dir.GetBucketPageId(index)).UpgradeWrite();
+  dir.Drop();
+  dir_guard.Drop();  // 已持有桶的锁，可以放开目录
+  if (!bucket_guard.IsValid()) {
+    return false;
   }
 
-  return ret;
+  // 先只读地检查，重复插入或桶满时不修改桶页，不会被标记为脏页，也不会使乐观读失效
+  auto *bucket_page = bucket_guard.As<HASH_TABLE_BUCKET_TYPE>();
+  if (bucket_page->Contains(key, value, comparator_, hash)) {
+    return false;
+  }
+  if (!bucket_page->IsFull()) {
+    return bucket_guard.AsMut<HASH_TABLE_BUCKET_TYPE>()->Insert(key, value, comparator_, hash);
+  }
+  bucket_guard.Drop();  // 该桶已满，插入失败，分裂时需要先加目录的写锁
+  return SplitInsert(transaction, key, value);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key, const ValueType &value) -> bool {
-  table_latch_.WLock();
-  bool ret;
+  /*
+  只在修改目录期间持有目录的写锁，其他桶上的操作只被阻塞这一小段时间
+  目录修改完成后新旧两个桶都持有写锁，放开目录后再迁移元素，访问这两个桶的线程等待迁移完成
+  */
+  WritePageGuard dir_guard = PinDirectoryPage().UpgradeWrite();
+  if (!dir_guard.IsValid()) {
+    return false;
+  }
+  HashTableDirectory dir = Directory(dir_guard.As<HashTableDirectoryPage>());
   // 待分裂桶的各项信息,称待分离桶为旧桶，申请的桶为新桶
-  uint32_t old_bucket_page_index = KeyToDirectoryIndex(key, dir_page_);
-  page_id_t old_bucket_page_id = KeyToPageId(key, dir_page_);
-  auto *old_bucket_page = FetchBucketPage(old_bucket_page_id);
-  uint32_t local_depth = dir_page_->GetLocalDepth(old_bucket_page_index);
+  uint32_t key_hash = Hash(key);
+  uint32_t old_bucket_page_index = key_hash & dir.GetGlobalDepthMask();
+  page_id_t old_bucket_page_id = dir.GetBucketPageId(old_bucket_page_index);
+  WritePageGuard old_bucket_guard = PinBucketPage(old_bucket_page_index, old_bucket_page_id).UpgradeWrite();
+  if (!old_bucket_guard.IsValid()) {
+    return false;
+  }
+  uint32_t local_depth = dir.GetLocalDepth(old_bucket_page_index);
 
-  if (!old_bucket_page->IsFull()) {  // 再次检查桶是否满了
-    ret = old_bucket_page->Insert(key, value, comparator_);
-    buffer_pool_manager_->UnpinPage(old_bucket_page_id, true, nullptr);
-    table_latch_.WUnlock();
-    return ret;
+  // 放开桶锁后可能已被其他线程插入了相同元素、分裂或删除了元素，再次只读地检查
+  auto *old_bucket_page = old_bucket_guard.As<HASH_TABLE_BUCKET_TYPE>();
+  if (old_bucket_page->Contains(key, value, comparator_, key_hash)) {
+    return false;
+  }
+  if (!old_bucket_page->IsFull()) {
+    dir.Drop();
+    dir_guard.Drop();
+    return old_bucket_guard.AsMut<HASH_TABLE_BUCKET_TYPE>()->Insert(key, value, comparator_, key_hash);
+  }
+  if (!old_bucket_page->HasCurrentLayout()) {
+    LOG_DEBUG("bucket page %d has the layout without fingerprints, cannot split it", old_bucket_page_id);
+    return false;
+  }
+  // 桶中元素与插入的键的hash值在目录最大深度内都相同时，分裂到最大深度也分不开，不再逐层分裂
+  // 各元素的hash值留到迁移时再用，不重复计算
+  std::array<uint32_t, HASH_TABLE_BUCKET_TYPE::SLOT_COUNT> bucket_hashes;
+  uint32_t differ_bits = 0;
+  for (uint32_t i = 0; i < old_bucket_page->Size(); i++) {
+    bucket_hashes[i] = Hash(old_bucket_page->KeyAt(i));
+    differ_bits |= bucket_hashes[i] ^ key_hash;
+  }
+  if ((differ_bits & ((1U << DIRECTORY_MAX_DEPTH) - 1)) == 0) {
+    LOG_DEBUG("all keys of the full bucket have the same hash, cannot split it");
+    return false;
   }
 
   page_id_t new_bucket_page_id;
-  auto *new_bucket_page = CreateBucketPage(&new_bucket_page_id);
+  WritePageGuard new_bucket_guard = CreateBucketPage(&new_bucket_page_id).UpgradeWrite();
+  if (!new_bucket_guard.IsValid()) {
+    LOG_DEBUG("failed to allocate a bucket page to split into");
+    return false;
+  }
+  dir_guard.GetDataMut();  // 以下修改目录
+  bool grow = local_depth == dir.GetGlobalDepth();  // 分裂后目录长度是否变成原来的两倍
+  uint32_t dir_size = dir.Size();
+  if (grow && !dir.IncrGlobalDepth()) {  // 目录已达最大深度或无法申请目录的段页，不能再分裂
+    new_bucket_guard.Drop();
+    DeleteBucketPage(new_bucket_page_id);
+    return false;
+  }
+  old_bucket_page = old_bucket_guard.AsMut<HASH_TABLE_BUCKET_TYPE>();  // 以下迁移元素，修改旧桶
+  auto *new_bucket_page = new_bucket_guard.AsMut<HASH_TABLE_BUCKET_TYPE>();
 
-  uint32_t old_local_mask = dir_page_->GetLocalDepthMask(old_bucket_page_index);  // 之前的掩码，例如111
+  uint32_t old_local_mask = dir.GetLocalDepthMask(old_bucket_page_index);  // 之前的掩码，例如111
   uint32_t new_local_mask = old_local_mask + (old_local_mask + 1);  // 计算新的掩码，比之前多一位，例如1111
   uint32_t old_local_hash = old_bucket_page_index & new_local_mask;  // 分裂后旧桶对应的hash值 例1011
   uint32_t new_local_hash = old_local_hash ^ (old_local_mask + 1);  // 分裂后新桶对应的hash值 例0011，对其最高位取反
-  uint32_t dir_size = dir_page_->Size();
 
   // 首先遍历一遍目录，将仍指向旧桶的位置深度加一
   // for (uint32_t i = 0; i < dir_size; i++) {
   //   if ((i & new_local_mask) == old_local_hash) {
-  //     dir_page_->IncrLocalDepth(i);
+  //     dir.IncrLocalDepth(i);
   //   }
   // }
   // 实现与上面代码一样的功能
   for (uint32_t i = old_local_hash; i < dir_size; i += new_local_mask + 1) {
-    dir_page_->IncrLocalDepth(i);
+    dir.IncrLocalDepth(i);
   }
 
   // 而后依据是否影响全局深度，对各位置进行操作
-  if (local_depth < dir_page_->GetGlobalDepth()) {  // 不影响目录大小，只是将一半指向旧桶的指针改向新桶
+  if (!grow) {  // 不影响目录大小，只是将一半指向旧桶的指针改向新桶
     // for (uint32_t i = 0; i < dir_size; i++) {
-    //   page_id = dir_page_->GetBucketPageId(i);
+    //   page_id = dir.GetBucketPageId(i);
     //   if (page_id == old_bucket_page_id &&
     //       (i & new_local_mask) != old_local_hash) {  // 与旧桶不再一致，将目录指向新桶并将深度加一
-    //     dir_page_->SetBucketPageId(i, new_bucket_page_id);
-    //     dir_page_->IncrLocalDepth(i);
+    //     dir.SetBucketPageId(i, new_bucket_page_id);
+    //     dir.IncrLocalDepth(i);
     //   }
     // }
 
     // 与上面代码实现一样的功能
     for (uint32_t i = new_local_hash; i < dir_size; i += new_local_mask + 1) {
-      dir_page_->SetBucketPageId(i, new_bucket_page_id);
-      dir_page_->IncrLocalDepth(i);
+      dir.SetBucketPageId(i, new_bucket_page_id);
+      dir.IncrLocalDepth(i);
+    }
+  } else {  // 目录长度变成原来的两倍，全局深度已在上面加一
+    uint32_t new_dir_size = dir.Size();
+    while (bucket_refs_.size() < dir.NumSegments()) {  // 目录的新段也需要swizzle引用，读者都持有目录锁，不会并发访问
+      bucket_refs_.push_back(std::make_unique<BucketRefs>());
     }
-  } else {  // 目录长度变成原来的两倍
-    dir_page_->IncrGlobalDepth();
-    uint32_t new_dir_size = dir_page_->Size();
     page_id_t upper_page_id;
     uint32_t upper_local_depth;
 
     // 下半部与上半部互成镜像，只是分裂的桶需修改page_id，其他的与上半部保持一致
     for (uint32_t i = dir_size; i < new_dir_size; i++) {
-      upper_page_id = dir_page_->GetBucketPageId(i - dir_size);
-      upper_local_depth = dir_page_->GetLocalDepth(i - dir_size);
+      upper_page_id = dir.GetBucketPageId(i - dir_size);
+      upper_local_depth = dir.GetLocalDepth(i - dir_size);
       if (upper_page_id == old_bucket_page_id) {  // 分裂桶对应的桶
-        dir_page_->SetBucketPageId(i, new_bucket_page_id);
+        dir.SetBucketPageId(i, new_bucket_page_id);
       } else {  // 其余桶，page id和depth与上半部保持一致
-        dir_page_->SetBucketPageId(i, upper_page_id);
+        dir.SetBucketPageId(i, upper_page_id);
       }
-      dir_page_->SetLocalDepth(i, upper_local_depth);  // 统一设置成与上半部一样的深度
+      dir.SetLocalDepth(i, upper_local_depth);  // 统一设置成与上半部一样的深度
     }
   }
+  dir.Drop();
+  dir_guard.Drop();  // 目录修改完成，以下不再读取目录，由hash值与新掩码判断元素所属的桶
+
   uint32_t bucket_size = old_bucket_page->Size();
   KeyType bucket_key;
   ValueType bucket_value;
-  page_id_t bucket_page_id;
   // 遍历旧桶中的元素，插入部分元素至新桶
   for (uint32_t i = 0; i < bucket_size; i++) {
-    bucket_key = old_bucket_page->KeyAt(i);
-    bucket_page_id = KeyToPageId(bucket_key, dir_page_);
-    if (bucket_page_id == new_bucket_page_id) {
+    if ((bucket_hashes[i] & new_local_mask) == new_local_hash) {
+      bucket_key = old_bucket_page->KeyAt(i);
       bucket_value = old_bucket_page->ValueAt(i);
       old_bucket_page->RemoveAt(i);
-      new_bucket_page->Insert(bucket_key, bucket_value, comparator_);
+      new_bucket_page->Insert(bucket_key, bucket_value, comparator_, bucket_hashes[i]);
     }
   }
+  old_bucket_page->Compact();  // 清除迁出的元素留下的墓碑，新桶是依次插入的，没有墓碑
 
   // 进行正常插入操作
-  bucket_page_id = KeyToPageId(key, dir_page_);
-  if (bucket_page_id == old_bucket_page_id) {
-    ret = old_bucket_page->Insert(key, value, comparator_);
-  } else {
-    ret = new_bucket_page->Insert(key, value, comparator_);
-  }
-  buffer_pool_manager_->UnpinPage(old_bucket_page_id, true, nullptr);
-  buffer_pool_manager_->UnpinPage(new_bucket_page_id, true, nullptr);
-  table_latch_.WUnlock();
-  return ret;
+  auto *bucket_page = (key_hash & new_local_mask) == old_local_hash ? old_bucket_page : new_bucket_page;
+  if (!bucket_page->IsFull()) {
+    return bucket_page->Insert(key, value, comparator_, key_hash);
+  }
+  // 旧桶的元素全部留在了插入的桶中，需要继续分裂
+  old_bucket_guard.Drop();
+  new_bucket_guard.Drop();
+  return SplitInsert(transaction, key, value);
 }
 
 /*****************************************************************************
@@ -244,18 +435,38 @@ auto HASH_TABLE_TYPE::SplitInsert(Transaction *transaction, const KeyType &key,
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const ValueType &value) -> bool {
-  table_latch_.RLock();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page_);
-  auto *bucket_page = FetchBucketPage(bucket_page_id);
+  ReadPageGuard dir_guard = PinDirectoryPage().UpgradeRead();
+  if (!dir_guard.IsValid()) {
+    return false;
+  }
+  HashTableDirectory dir = Directory(dir_guard.As<HashTableDirectoryPage>());
+  uint32_t hash = Hash(key);
+  uint32_t index = hash & dir.GetGlobalDepthMask();
+  WritePageGuard bucket_guard = PinBucketPage(index, dir.GetBucketPageId(index)).UpgradeWrite();
+  if (!bucket_guard.IsValid()) {
+    return false;
+  }
+  page_id_t image_page_id = INVALID_PAGE_ID;  // 镜像桶，合并时会读取
+  if (dir.GetLocalDepth(index) > 0) {
+    image_page_id = dir.GetBucketPageId(dir.GetSplitImageIndex(index));
+  }
+  dir.Drop();
+  dir_guard.Drop();  // 已持有桶的锁，可以放开目录
 
-  reinterpret_cast<Page *>(bucket_page)->WLatch();
-  bool ret = bucket_page->Remove(key, value, comparator_);
-  reinterpret_cast<Page *>(bucket_page)->WUnlatch();
+  // 先只读地查找，删除不存在的元素时不修改桶页
+  if (!bucket_guard.As<HASH_TABLE_BUCKET_TYPE>()->Contains(key, value, comparator_, hash)) {
+    return false;
+  }
+  bool ret = bucket_guard.AsMut<HASH_TABLE_BUCKET_TYPE>()->Remove(key, value, comparator_, hash);
+  bool empty = ret && bucket_guard.As<HASH_TABLE_BUCKET_TYPE>()->IsEmpty();  // 持有页锁时判断，放回后该页可能被换出
+  bucket_guard.Drop();  // 要提前unpin，有可能要删除该桶
 
-  buffer_pool_manager_->UnpinPage(bucket_page_id, true, nullptr);  // 要提前unpin，有可能要删除该桶
-  table_latch_.RUnlock();
+  // 桶被删空后接下来要合并，合并时会读取其镜像桶，提前预取，读盘与等待目录写锁重叠进行
+  if (empty && prefetcher_ != nullptr && image_page_id != INVALID_PAGE_ID) {
+    prefetcher_->PrefetchPage(image_page_id);
+  }
   // 若当前桶为空，需要进行合并操作，合并完之后判断是否需要循环合并
-  if (ret && bucket_page->IsEmpty()) {
+  if (empty) {
     Merge(transaction, key, value);
     while (ExtraMerge(transaction, key, value)) {
     }
@@ -269,118 +480,142 @@ auto HASH_TABLE_TYPE::Remove(Transaction *transaction, const KeyType &key, const
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_TYPE::Merge(Transaction *transaction, const KeyType &key, const ValueType &value) {
-  table_latch_.WLock();
-  uint32_t index = KeyToDirectoryIndex(key, dir_page_);  // 索引值，例如为1011
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page_);
-  uint32_t dir_size = dir_page_->Size();
-  uint32_t local_depth = dir_page_->GetLocalDepth(index);         // 局部深度，例如为3
-  uint32_t old_local_mask = dir_page_->GetLocalDepthMask(index);  // 合并前掩码，例如为111
+  WritePageGuard dir_guard = PinDirectoryPage().UpgradeWrite();
+  if (!dir_guard.IsValid()) {
+    return;  // 不合并，空桶留到之后的删除再合并
+  }
+  HashTableDirectory dir = Directory(dir_guard.As<HashTableDirectoryPage>());
+  uint32_t index = KeyToDirectoryIndex(key, &dir);  // 索引值，例如为1011
+  page_id_t bucket_page_id = KeyToPageId(key, &dir);
+  uint32_t dir_size = dir.Size();
+  uint32_t local_depth = dir.GetLocalDepth(index);         // 局部深度，例如为3
+  uint32_t old_local_mask = dir.GetLocalDepthMask(index);  // 合并前掩码，例如为111
   uint32_t new_local_mask = old_local_mask ^ (1 << (local_depth - 1));  // 合并后的掩码，将最高位的1去掉，例如为11
   uint32_t old_local_hash = index & old_local_mask;                     // 与后的值，例如为011
   uint32_t new_local_hash = index & new_local_mask;                     // 与后的值，例如为11
 
-  auto *bucket_page = FetchBucketPage(bucket_page_id);
+  // 持有目录写锁时不会再有线程找到该桶，加桶的写锁等待已找到该桶的线程完成
+  WritePageGuard bucket_guard = PinBucketPage(index, bucket_page_id).UpgradeWrite();
+  if (!bucket_guard.IsValid()) {
+    return;
+  }
+  auto *bucket_page = bucket_guard.As<HASH_TABLE_BUCKET_TYPE>();
   bool merge_occur = false;  // 标志是否发生合并
 
-  if (local_depth > 0 && bucket_page->IsEmpty()) {  // remove函数加的是读锁，有可能已经插入新值
+  if (local_depth > 0 && bucket_page->IsEmpty()) {  // 删空后放开了桶的锁，有可能已经插入新值
     // 获取与空桶对应的桶的信息，如果两者深度一致，则可以合并成一个桶
     page_id_t another_bucket_page_id;
-    uint32_t another_bucket_idx = dir_page_->GetSplitImageIndex(index);
-    uint32_t another_local_depth = dir_page_->GetLocalDepth(another_bucket_idx);
+    uint32_t another_bucket_idx = dir.GetSplitImageIndex(index);
+    uint32_t another_local_depth = dir.GetLocalDepth(another_bucket_idx);
     if (another_local_depth == local_depth) {  // 此时可以进行合并操作
       merge_occur = true;
-      another_bucket_page_id = dir_page_->GetBucketPageId(another_bucket_idx);
+      another_bucket_page_id = dir.GetBucketPageId(another_bucket_idx);
     }
     if (merge_occur) {
+      dir_guard.GetDataMut();  // 以下修改目录
       // for (uint32_t i = 0; i < dir_size; i++) {
       //   if ((i & old_local_mask) == (index & old_local_mask)) {  // 寻找指向空桶的指针,将其指向另一半another_bucket
-      //     dir_page_->SetBucketPageId(i, another_bucket_page_id);
+      //     dir.SetBucketPageId(i, another_bucket_page_id);
       //   }
       // }
 
       // 与上面代码实现一样的功能
       for (uint32_t i = old_local_hash; i < dir_size; i += old_local_mask + 1) {
-        dir_page_->SetBucketPageId(i, another_bucket_page_id);
+        dir.SetBucketPageId(i, another_bucket_page_id);
       }
 
       // for (uint32_t i = 0; i < dir_size; i++) {
       //   if ((i & new_local_mask) == (index & new_local_mask)) {  // 将所有指向another_bucket的local depth都减一
-      //     dir_page_->DecrLocalDepth(i);
+      //     dir.DecrLocalDepth(i);
       //   }
       // }
 
       // 与上面代码实现一样的功能
       for (uint32_t i = new_local_hash; i < dir_size; i += new_local_mask + 1) {
-        dir_page_->DecrLocalDepth(i);
+        dir.DecrLocalDepth(i);
       }
-      buffer_pool_manager_->UnpinPage(bucket_page_id, false, nullptr);  // 先unpin再删除
-      buffer_pool_manager_->DeletePage(bucket_page_id, nullptr);
-      bool ret = dir_page_->CanShrink();
+      bucket_guard.Drop();  // 先unpin再删除
+      DeleteBucketPage(bucket_page_id);
+      bool ret = dir.CanShrink();
       if (ret) {  // 降低全局深度
-        dir_page_->DecrGlobalDepth();
+        dir.DecrGlobalDepth();
       }
     }
   }
-  if (!merge_occur) {  // 合并未发生
-    buffer_pool_manager_->UnpinPage(bucket_page_id, false, nullptr);
-  }
-  table_latch_.WUnlock();
 }
 
 // 循环合并
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_TYPE::ExtraMerge(Transaction *transaction, const KeyType &key, const ValueType &value) -> bool {
-  table_latch_.WLock();
-  page_id_t bucket_page_id = KeyToPageId(key, dir_page_);
-  uint32_t index = KeyToDirectoryIndex(key, dir_page_);
-  uint32_t local_depth = dir_page_->GetLocalDepth(index);
-  uint32_t dir_size = dir_page_->Size();
+  WritePageGuard dir_guard = PinDirectoryPage().UpgradeWrite();
+  if (!dir_guard.IsValid()) {
+    return false;
+  }
+  HashTableDirectory dir = Directory(dir_guard.As<HashTableDirectoryPage>());
+  page_id_t bucket_page_id = KeyToPageId(key, &dir);
+  uint32_t index = KeyToDirectoryIndex(key, &dir);
+  uint32_t local_depth = dir.GetLocalDepth(index);
+  uint32_t dir_size = dir.Size();
   bool extra_merge_occur = false;
   if (local_depth > 0) {
     // 计算合并后桶对应的桶的各项信息，该桶有可能因为已经为空但由于深度不一致没有合并
-    auto extra_bucket_idx = dir_page_->GetSplitImageIndex(index);
-    auto extra_local_depth = dir_page_->GetLocalDepth(extra_bucket_idx);
-    auto extra_bucket_page_id = dir_page_->GetBucketPageId(extra_bucket_idx);
-    auto *extra_bucket = FetchBucketPage(extra_bucket_page_id);
+    auto extra_bucket_idx = dir.GetSplitImageIndex(index);
+    auto extra_local_depth = dir.GetLocalDepth(extra_bucket_idx);
+    auto extra_bucket_page_id = dir.GetBucketPageId(extra_bucket_idx);
+    WritePageGuard extra_bucket_guard = PinBucketPage(extra_bucket_idx, extra_bucket_page_id).UpgradeWrite();
+    if (!extra_bucket_guard.IsValid()) {
+      return false;
+    }
+    auto *extra_bucket = extra_bucket_guard.As<HASH_TABLE_BUCKET_TYPE>();
     if (extra_local_depth == local_depth && extra_bucket->IsEmpty()) {  // 进行合并操作
       extra_merge_occur = true;
+      dir_guard.GetDataMut();  // 以下修改目录
 
-      uint32_t old_local_mask = dir_page_->GetLocalDepthMask(extra_bucket_idx);
+      uint32_t old_local_mask = dir.GetLocalDepthMask(extra_bucket_idx);
       uint32_t new_local_mask = old_local_mask ^ (1 << (local_depth - 1));
       uint32_t old_local_hash = extra_bucket_idx & old_local_mask;
       uint32_t new_local_hash = extra_bucket_idx & new_local_mask;
       for (uint32_t i = old_local_hash; i < dir_size; i += old_local_mask + 1) {
-        dir_page_->SetBucketPageId(i, bucket_page_id);
+        dir.SetBucketPageId(i, bucket_page_id);
       }
       for (uint32_t i = new_local_hash; i < dir_size; i += new_local_mask + 1) {
-        dir_page_->DecrLocalDepth(i);
+        dir.DecrLocalDepth(i);
       }
-      buffer_pool_manager_->UnpinPage(extra_bucket_page_id, false, nullptr);  // 先unpin再删除
-      buffer_pool_manager_->DeletePage(extra_bucket_page_id, nullptr);
+      extra_bucket_guard.Drop();  // 先unpin再删除
+      DeleteBucketPage(extra_bucket_page_id);
 
-      bool ret = dir_page_->CanShrink();
+      bool ret = dir.CanShrink();
       if (ret) {  // 降低全局深度
-        dir_page_->DecrGlobalDepth();
+        dir.DecrGlobalDepth();
       }
     }
-    if (!extra_merge_occur) {  // 循环合并未发生
-      buffer_pool_manager_->UnpinPage(extra_bucket_page_id, false, nullptr);
-    }
   }
-  buffer_pool_manager_->UnpinPage(bucket_page_id, false, nullptr);
-  table_latch_.WUnlock();
   return extra_merge_occur;
 }
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::DeleteBucketPage(page_id_t bucket_page_id) {
+  // 其他线程放开桶的锁后才unpin，合并时该桶可能还未被放回，删除失败时留到之后的合并再删
+  retired_pages_.push_back(bucket_page_id);
+  auto iter = retired_pages_.begin();
+  while (iter != retired_pages_.end()) {
+    if (buffer_pool_manager_->DeletePage(*iter, nullptr)) {
+      iter = retired_pages_.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+}
 /*****************************************************************************
  * GETGLOBALDEPTH - DO NOT TOUCH
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_TYPE::GetGlobalDepth() -> uint32_t {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
+  // 分裂与合并只持有目录页的写锁，加目录页的读锁与之互斥
+  ReadPageGuard dir_guard = PinDirectoryPage().UpgradeRead();
+  assert(dir_guard.IsValid());
+  HashTableDirectoryPage *dir_page = dir_guard.As<HashTableDirectoryPage>();
   uint32_t global_depth = dir_page->GetGlobalDepth();
-  assert(buffer_pool_manager_->UnpinPage(directory_page_id_, false, nullptr));
-  table_latch_.RUnlock();
   return global_depth;
 }
 
@@ -389,11 +624,17 @@ auto HASH_TABLE_TYPE::GetGlobalDepth() -> uint32_t {
  *****************************************************************************/
 template <typename KeyType, typename ValueType, typename KeyComparator>
 void HASH_TABLE_TYPE::VerifyIntegrity() {
-  table_latch_.RLock();
-  HashTableDirectoryPage *dir_page = FetchDirectoryPage();
+  ReadPageGuard dir_guard = PinDirectoryPage().UpgradeRead();
+  assert(dir_guard.IsValid());
+  HashTableDirectoryPage *dir_page = dir_guard.As<HashTableDirectoryPage>();
   dir_page->VerifyIntegrity();
-  assert(buffer_pool_manager_->UnpinPage(directory_page_id_, false, nullptr));
-  table_latch_.RUnlock();
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_TYPE::VerifyDirectoryIntegrity() {
+  ReadPageGuard dir_guard = PinDirectoryPage().UpgradeRead();
+  assert(dir_guard.IsValid());
+  Directory(dir_guard.As<HashTableDirectoryPage>()).VerifyIntegrity();  // 目录可能跨多个页
 }
 
 /*****************************************************************************
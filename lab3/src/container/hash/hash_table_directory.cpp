@@ -0,0 +1,136 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_directory.cpp
+//
+// Identification: src/container/hash/hash_table_directory.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "container/hash/hash_table_directory.h"
+
+#include <cassert>
+#include <unordered_map>
+#include <utility>
+
+#include "common/logger.h"
+
+namespace bustub {
+
+auto HashTableDirectory::Segment(uint32_t *bucket_idx, bool for_write) -> HashTableDirectoryPage * {
+  uint32_t segment_idx = *bucket_idx / DIRECTORY_ARRAY_SIZE;
+  *bucket_idx %= DIRECTORY_ARRAY_SIZE;
+  if (segment_idx == 0) {
+    return root_;  // 第0段就是根页本身
+  }
+  if (segments_.size() <= segment_idx) {
+    segments_.resize(NumSegments());
+  }
+  BasicPageGuard &guard = segments_[segment_idx];
+  if (!guard.IsValid()) {
+    guard = PinPageThroughRef(bpm_, swizzler_, &segment_refs_[segment_idx], root_->GetSegmentPageId(segment_idx));
+  }
+  return for_write ? guard.AsMut<HashTableDirectoryPage>() : guard.As<HashTableDirectoryPage>();
+}
+
+auto HashTableDirectory::GetBucketPageId(uint32_t bucket_idx) -> page_id_t {
+  return Segment(&bucket_idx, false)->GetBucketPageId(bucket_idx);
+}
+
+void HashTableDirectory::SetBucketPageId(uint32_t bucket_idx, page_id_t bucket_page_id) {
+  Segment(&bucket_idx, true)->SetBucketPageId(bucket_idx, bucket_page_id);
+}
+
+auto HashTableDirectory::GetLocalDepth(uint32_t bucket_idx) -> uint32_t {
+  return Segment(&bucket_idx, false)->GetLocalDepth(bucket_idx);
+}
+
+void HashTableDirectory::SetLocalDepth(uint32_t bucket_idx, uint8_t local_depth) {
+  Segment(&bucket_idx, true)->SetLocalDepth(bucket_idx, local_depth);
+}
+
+void HashTableDirectory::IncrLocalDepth(uint32_t bucket_idx) { Segment(&bucket_idx, true)->IncrLocalDepth(bucket_idx); }
+
+void HashTableDirectory::DecrLocalDepth(uint32_t bucket_idx) { Segment(&bucket_idx, true)->DecrLocalDepth(bucket_idx); }
+
+auto HashTableDirectory::GetSplitImageIndex(uint32_t bucket_idx) -> uint32_t {
+  uint32_t local_depth = GetLocalDepth(bucket_idx);
+  if (local_depth == 0) {
+    return 0;
+  }
+  return (bucket_idx ^ (1 << (local_depth - 1))) & ((1 << local_depth) - 1);
+}
+
+auto HashTableDirectory::IncrGlobalDepth() -> bool {
+  if (root_->GetGlobalDepth() >= DIRECTORY_MAX_DEPTH) {
+    LOG_DEBUG("hash table directory is at its maximum depth %u", DIRECTORY_MAX_DEPTH);
+    return false;
+  }
+  // 目录翻倍后超出已分配的段时，先申请新的段页，全部申请成功后才增加全局深度
+  uint32_t new_num_segments = (Size() * 2 + DIRECTORY_ARRAY_SIZE - 1) / DIRECTORY_ARRAY_SIZE;
+  if (segments_.size() < new_num_segments) {
+    segments_.resize(new_num_segments);
+  }
+  for (uint32_t segment_idx = root_->GetNumSegmentPages() + 1; segment_idx < new_num_segments; segment_idx++) {
+    page_id_t segment_page_id;
+    BasicPageGuard guard = NewPageGuarded(bpm_, &segment_page_id);
+    if (!guard.IsValid()) {
+      LOG_DEBUG("failed to allocate a hash table directory segment page");
+      return false;
+    }
+    guard.AsMut<HashTableDirectoryPage>()->SetPageId(segment_page_id);
+    root_->SetSegmentPageId(segment_idx, segment_page_id);
+    root_->SetNumSegmentPages(segment_idx);
+    segments_[segment_idx] = std::move(guard);
+  }
+  root_->IncrGlobalDepth();
+  return true;
+}
+
+auto HashTableDirectory::CanShrink() -> bool {
+  uint32_t global_depth = GetGlobalDepth();
+  uint32_t dir_size = Size();
+  for (uint32_t index = 0; index < dir_size; index++) {
+    if (GetLocalDepth(index) == global_depth) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void HashTableDirectory::VerifyIntegrity() {
+  if (Size() <= DIRECTORY_ARRAY_SIZE) {
+    root_->VerifyIntegrity();
+    return;
+  }
+  std::unordered_map<page_id_t, uint32_t> page_id_to_count;
+  std::unordered_map<page_id_t, uint32_t> page_id_to_ld;
+  uint32_t global_depth = GetGlobalDepth();
+  for (uint32_t curr_idx = 0; curr_idx < Size(); curr_idx++) {
+    page_id_t curr_page_id = GetBucketPageId(curr_idx);
+    uint32_t curr_ld = GetLocalDepth(curr_idx);
+    assert(curr_ld <= global_depth);
+    ++page_id_to_count[curr_page_id];
+    auto iter = page_id_to_ld.find(curr_page_id);
+    if (iter != page_id_to_ld.end() && iter->second != curr_ld) {
+      LOG_WARN("Verify Integrity: curr_local_depth: %u, old_local_depth %u, for page_id: %u", curr_ld, iter->second,
+               curr_page_id);
+      assert(curr_ld == iter->second);
+    } else {
+      page_id_to_ld[curr_page_id] = curr_ld;
+    }
+  }
+  for (const auto &[curr_page_id, curr_count] : page_id_to_count) {
+    uint32_t required_count = 0x1 << (global_depth - page_id_to_ld[curr_page_id]);
+    if (curr_count != required_count) {
+      LOG_WARN("Verify Integrity: curr_count: %u, required_count %u, for page_id: %u", curr_count, required_count,
+               curr_page_id);
+      assert(curr_count == required_count);
+    }
+  }
+}
+
+}  // namespace bustub
@@ -56,7 +56,27 @@ auto SeqScanExecutor::SchemaEqual(const Schema *table_schema, const Schema *outp
   }
   return true;
 }
+void SeqScanExecutor::PrefetchNextPage() {
+  page_id_t page_id = table_iter_->GetRid().GetPageId();
+  if (prefetcher_ == nullptr || optimistic_reader_ == nullptr || page_id == current_page_id_) {
+    return;
+  }
+  current_page_id_ = page_id;
+  // 进入新页时预取表堆中的下一页，读盘与处理当前页的元组重叠进行
+  // 当前页刚被迭代器读入，不pin不加锁地乐观读出下一页的id，读取失败时本页不预取
+  OptimisticRead read;
+  if (!optimistic_reader_->TryOptimisticRead(page_id, &read)) {
+    return;
+  }
+  auto *page = reinterpret_cast<TablePage *>(const_cast<char *>(read.GetData()));
+  page_id_t next_page_id = page->GetNextPageId();
+  if (read.Validate() && next_page_id != INVALID_PAGE_ID) {
+    prefetcher_->PrefetchScanPage(next_page_id);
+  }
+}
+
 void SeqScanExecutor::Init() {
+  ScanRing::Guard scan_guard(&scan_ring_);
   auto table_oid = plan_->GetTableOid();
   table_info_ = exec_ctx_->GetCatalog()->GetTable(table_oid);
   table_iter_ = table_info_->table_->Begin(exec_ctx_->GetTransaction());
@@ -64,6 +84,9 @@ void SeqScanExecutor::Init() {
   auto output_schema = plan_->OutputSchema();
   auto table_schema = table_info_->schema_;
   is_same_schema_ = SchemaEqual(&table_schema, output_schema);
+  prefetcher_ = PagePrefetcher::FromBufferPool(exec_ctx_->GetBufferPoolManager());
+  optimistic_reader_ = OptimisticPageReader::FromBufferPool(exec_ctx_->GetBufferPoolManager());
+  current_page_id_ = INVALID_PAGE_ID;
 
   // 可重复读：给所有元组加上读锁，事务提交后再解锁
   auto transaction = exec_ctx_->GetTransaction();
@@ -79,6 +102,7 @@ void SeqScanExecutor::Init() {
 }
 
 auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
+  ScanRing::Guard scan_guard(&scan_ring_);  // 遍历表堆时的缺页都使用扫描环
   auto predicate = plan_->GetPredicate();
   auto output_schema = plan_->OutputSchema();
   auto table_schema = table_info_->schema_;
@@ -87,6 +111,7 @@ auto SeqScanExecutor::Next(Tuple *tuple, RID *rid) -> bool {
   bool res;
 
   while (table_iter_ != table_info_->table_->End()) {
+    PrefetchNextPage();
     // 读已提交：读元组时加上读锁，读完后立即释放
     if (transaction->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
       lockmanager->LockShared(transaction, table_iter_->GetRid());
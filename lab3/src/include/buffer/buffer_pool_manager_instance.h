@@ -12,30 +12,73 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
 #include <list>
-#include <mutex>  // NOLINT
+#include <memory>
+#include <mutex>   // NOLINT
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_stats.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/frame_arena.h"
+#include "buffer/lru_k_replacer.h"
 #include "buffer/lru_replacer.h"
+#include "buffer/optimistic_page_reader.h"
+#include "buffer/page_prefetcher.h"
+#include "buffer/page_swizzler.h"
+#include "buffer/partitioned_lru_replacer.h"
+#include "buffer/scan_ring.h"
 #include "recovery/log_manager.h"
+#include "storage/disk/disk_io.h"
 #include "storage/disk/disk_manager.h"
 #include "storage/page/page.h"
 
 namespace bustub {
 
+/** Replacement policy of a BufferPoolManagerInstance. */
+enum class ReplacerPolicy {
+  /** LRUReplacer, exact least recently used. */
+  LRU,
+  /** ClockReplacer, second chance approximation of LRU with latch-free Pin/Unpin. */
+  CLOCK,
+  /** LRUKReplacer, evicts by backward k-distance so sequential scans do not flush the hot set. */
+  LRU_K,
+  /** PartitionedLRUReplacer, approximate LRU with per-partition latches and batched unpins, for many threads. */
+  PARTITIONED_LRU
+};
+
 /**
  * BufferPoolManager reads disk pages to and from its internal buffer pool.
  */
-class BufferPoolManagerInstance : public BufferPoolManager {
+class BufferPoolManagerInstance : public BufferPoolManager,
+                                  public PagePrefetcher,
+                                  public OptimisticPageReader,
+                                  public PageSwizzler {
  public:
   /**
    * Creates a new BufferPoolManagerInstance.
    * @param pool_size the size of the buffer pool
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_policy the replacement policy used to pick victim frames
+   * @param replacer_k the k of the LRU-K policy, ignored by the other policies
+   * @param arena_options huge page and NUMA placement of the frames
    */
-  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr);
+  BufferPoolManagerInstance(size_t pool_size, DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerPolicy replacer_policy = ReplacerPolicy::LRU,
+                            size_t replacer_k = LRUK_REPLACER_K,
+                            const FrameArenaOptions &arena_options = FrameArenaOptions());
   /**
    * Creates a new BufferPoolManagerInstance.
    * @param pool_size the size of the buffer pool
@@ -43,9 +86,15 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    * @param instance_index index of this BPI in the parallel BPM
    * @param disk_manager the disk manager
    * @param log_manager the log manager (for testing only: nullptr = disable logging)
+   * @param replacer_policy the replacement policy used to pick victim frames
+   * @param replacer_k the k of the LRU-K policy, ignored by the other policies
+   * @param arena_options huge page and NUMA placement of the frames
    */
   BufferPoolManagerInstance(size_t pool_size, uint32_t num_instances, uint32_t instance_index,
-                            DiskManager *disk_manager, LogManager *log_manager = nullptr);
+                            DiskManager *disk_manager, LogManager *log_manager = nullptr,
+                            ReplacerPolicy replacer_policy = ReplacerPolicy::LRU,
+                            size_t replacer_k = LRUK_REPLACER_K,
+                            const FrameArenaOptions &arena_options = FrameArenaOptions());
 
   /**
    * Destroys an existing BufferPoolManagerInstance.
@@ -55,8 +104,154 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return size of the buffer pool */
   auto GetPoolSize() -> size_t override { return pool_size_; }
 
-  /** @return pointer to all the pages in the buffer pool */
-  auto GetPages() -> Page * { return pages_; }
+  /** @return size the buffer pool can grow to, FrameArenaOptions::max_frame_count_ given at construction */
+  auto GetMaxPoolSize() const -> size_t { return max_pool_size_; }
+
+  /**
+   * Grow or shrink the buffer pool while it is in use. Growing adds free frames. Shrinking removes the frames at the
+   * end of the pool: their pages move to free frames while there are any and are evicted otherwise, pinned pages are
+   * waited for until they are unpinned. The memory of removed frames is returned to the system.
+   * @param pool_size new size of the buffer pool, between 1 and GetMaxPoolSize()
+   * @param drain_timeout how long shrinking waits for pinned pages
+   * @return false if pool_size is out of range or pinned pages were not unpinned in time, the size is then unchanged
+   */
+  auto ResizePool(size_t pool_size, std::chrono::milliseconds drain_timeout = std::chrono::milliseconds(1000)) -> bool;
+
+  /**
+   * @return pointer to all the pages in the buffer pool; with FrameArenaOptions::aligned_frames_ only the first page,
+   * the frames are then not an array of Page
+   */
+  auto GetPages() -> Page * { return frame_arena_->Frames(); }
+
+  /**
+   * @return number of frames a NewPage could take without failing: free frames plus evictable frames. The count is
+   * only a hint, it may be stale as soon as it is returned.
+   */
+  auto GetAvailableFrameCount() -> size_t {
+    return num_free_frames_.load(std::memory_order_relaxed) + replacer_->Size();
+  }
+
+  /** @return the statistics of this instance since construction or the last ResetStats() */
+  auto GetStats() const -> BufferPoolStats { return stats_.Snapshot(); }
+
+  /** Reset the statistics of this instance. */
+  void ResetStats() { stats_.Reset(); }
+
+  /**
+   * @param count maximum number of pages to return
+   * @return the resident pages with the most buffer hits since they were read in, hottest first
+   */
+  auto GetHottestPages(size_t count) -> std::vector<PageHeat>;
+
+  /**
+   * Start a background thread that writes back dirty, unpinned pages close to the tail of the replacer, so that
+   * foreground eviction almost always finds clean frames. Restarts the flusher if it is already running.
+   * @param interval time between two flush rounds
+   * @param pages_per_round maximum number of pages written per round; it looks at 4x as many frames from the tail
+   * @param dirty_watermark a round only writes while more than this fraction of the frames is dirty
+   */
+  void StartBackgroundFlusher(std::chrono::milliseconds interval = std::chrono::milliseconds(10),
+                              size_t pages_per_round = 32, double dirty_watermark = 0.1);
+
+  /**
+   * Stop the background flusher, if it is running. Called by the destructor.
+   */
+  void StopBackgroundFlusher();
+
+  /**
+   * Schedule an asynchronous read of page_id on the prefetch threads of this instance. Pages that do not belong to
+   * this instance or were never allocated are ignored, and the request is dropped if the prefetch queue is full.
+   * @param page_id id of page to be prefetched
+   */
+  void PrefetchPage(page_id_t page_id) override;
+
+  /**
+   * Like PrefetchPage, but the page is read into the frames of the scan ring of the prefetch threads.
+   * @param page_id id of page to be prefetched
+   */
+  void PrefetchScanPage(page_id_t page_id) override;
+
+  /**
+   * Schedule asynchronous reads of the pages of this instance in [first_page_id, first_page_id + count).
+   * @param first_page_id id of the first page to be prefetched
+   * @param count number of pages
+   */
+  void PrefetchRange(page_id_t first_page_id, size_t count) override;
+
+  /**
+   * Write the ids of the resident pages to a file, most recently used first: pinned pages, then the unpinned pages
+   * in reverse replacer order. The file is replaced atomically. Used by WarmUp after a restart.
+   * @param path the dump file
+   * @return false if the file could not be written
+   */
+  auto DumpResidentPages(const std::string &path) -> bool;
+
+  /**
+   * Dump the resident pages to path every interval on a background thread, and once more when the dumps are stopped
+   * or the instance is destroyed. Restarts the dumps if they are already running.
+   * @param path the dump file
+   * @param interval time between two dumps
+   */
+  void StartWarmUpDumps(const std::string &path, std::chrono::milliseconds interval = std::chrono::minutes(1));
+
+  /** Stop the periodic dumps with a final dump, if they are running. Called by the destructor. */
+  void StopWarmUpDumps();
+
+  /**
+   * Reload the pages of a DumpResidentPages file that belong to this instance. The most recently used pages that fit
+   * into the free frames are read in page id order, in batches whose reads are submitted together, and are installed
+   * unpinned. Loading stops early once the pool has no free frames left, so it never evicts pages used meanwhile.
+   * Page ids this instance has not allocated are skipped, and a damaged file is read no further than its size.
+   * @param path the dump file
+   * @param wait true to return once the pages are loaded, false to load them on a background thread while the buffer
+   * pool serves requests
+   * @return the number of pages scheduled for loading, 0 if the file could not be read
+   */
+  auto WarmUp(const std::string &path, bool wait = false) -> size_t;
+
+  /** Wait until a background WarmUp finished loading. */
+  void WaitWarmUp();
+
+  /** Stop a background WarmUp, if one is running. Called by the destructor. */
+  void StopWarmUp();
+
+  /**
+   * Start an optimistic read of a resident page. The frame of the page is found through a latch-free location hint
+   * table, so a hit writes nothing shared; only a hint miss looks the page up under its shard latch.
+   * @param page_id id of the page to be read
+   * @param[out] read the read, to be validated after the page content was read
+   * @return false if the page is not resident or is being modified
+   */
+  auto TryOptimisticRead(page_id_t page_id, OptimisticRead *read) -> bool override;
+
+  /** Mark a pinned page as being modified, the caller holds its write latch. */
+  void BeginPageWrite(Page *page) override;
+
+  /** Finish a modification started with BeginPageWrite. */
+  void EndPageWrite(Page *page) override;
+
+  /**
+   * Pin a page through a swizzled reference with one atomic increment of the swizzle pin count of its frame. Swizzle
+   * pins keep the page from being evicted or deleted like pin_count_, but the frame stays in the replacer; a victim
+   * found swizzle-pinned is put back as most recently used, and a sample of the pins is recorded as replacer
+   * references (see SWIZZLE_REFERENCE_SAMPLE_RATE).
+   * @param page a Page pointer once returned for page_id by this instance
+   * @param page_id id of the page the reference was swizzled for
+   * @return false if the frame no longer holds page_id
+   */
+  auto PinSwizzled(Page *page, page_id_t page_id) -> bool override;
+
+  /** Unpin a page pinned with PinSwizzled, only marking it dirty takes its shard latch. */
+  void UnpinSwizzled(Page *page, bool is_dirty) override;
+
+  /**
+   * Replace the page I/O backend, by default pages are read and written synchronously through the DiskManager.
+   * Must be called before the buffer pool is used.
+   * @param disk_io the new backend, e.g. DiskIO::Create(disk_manager, db_file), or with direct_io to make the buffer
+   * pool the only cache of the pages; direct_io copies every page through a bounce buffer unless the pool was created
+   * with FrameArenaOptions::aligned_frames_
+   */
+  void SetDiskIO(std::unique_ptr<DiskIO> disk_io);
 
  protected:
   /**
@@ -96,7 +291,9 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   auto DeletePgImp(page_id_t page_id) -> bool override;
 
   /**
-   * Flushes all the pages in the buffer pool to disk.
+   * Flushes all the dirty pages, and the pages never written to disk yet, in the buffer pool to disk, in page id order
+   * and without holding any latch during the writes. Runs of consecutive page ids are written with a single I/O.
+   * Pinned pages are written under their read latch, so the caller must not hold a page write latch.
    */
   void FlushAllPgsImp() override;
 
@@ -121,12 +318,253 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   void ValidatePageId(page_id_t page_id) const;
 
-  // 获取页框，进入函数前需加锁
+  /**
+   * A shard of the page table. The shard latch protects the page_id -> frame_id mapping of this shard, as well as
+   * pin_count_, is_dirty_ and the I/O state of every frame whose page maps into this shard, so a buffer hit only needs
+   * this latch.
+   */
+  struct PageTableShard {
+    std::mutex latch_;
+    std::unordered_map<page_id_t, frame_id_t> table_;
+    /** Pages created by NewPage that have never been written to disk, fetching one zero-fills the frame. */
+    std::unordered_set<page_id_t> unpersisted_;
+    /** Signalled whenever a frame of this shard finishes its in-flight I/O. */
+    std::condition_variable io_done_;
+  };
+
+  /** Which resident pages a write-back covers. */
+  enum class FlushMode : uint8_t {
+    /** Dirty, unpinned pages, written by the background flusher. */
+    UNPINNED_DIRTY,
+    /**
+     * Dirty or pinned pages, pinned pages may carry changes not yet reported by UnpinPage, and pages never written to
+     * disk yet. Used by FlushAllPages.
+     */
+    CHECKPOINT,
+    /** Any page, used by FlushPage. */
+    ALWAYS
+  };
+
+  /** Outcome of BeginFlush. */
+  enum class FlushStart : uint8_t {
+    /** The page is not to be written, or I/O on it is in progress. */
+    SKIPPED,
+    /** The page was copied and marked FLUSHING. */
+    STARTED,
+    /**
+     * The page is pinned, so its read latch is needed for the copy, and the caller did not allow blocking on it. The
+     * caller must first finish the write-backs it started, then call BeginFlush again with may_latch.
+     */
+    NEEDS_LATCH
+  };
+
+  /** In-flight disk I/O of a frame, the instance latch is not held while it is in progress. */
+  enum class FrameIOState : uint8_t {
+    /** No I/O in progress. */
+    IDLE,
+    /** The page is being read from disk. Fetchers pin the frame and wait. */
+    LOADING,
+    /** The dirty page is being written back before eviction. Fetchers wait and look the page up again. */
+    EVICTING,
+    /** The page is being written back but stays resident. Fetchers may pin it, eviction and deletion wait. */
+    FLUSHING
+  };
+
+  /** @return the page in frame frame_id, owned by frame_arena_ */
+  auto FramePage(size_t frame_id) -> Page & { return frame_arena_->Frame(frame_id); }
+
+  /**
+   * Make optimistic reads of frame_id fail from now on: make its version odd. Called before the page in the frame is
+   * removed or replaced, under the shard latch of the page.
+   */
+  void InvalidateFrame(frame_id_t frame_id);
+
+  /**
+   * Make the page in frame_id readable optimistically: make its version even and record the frame in the location
+   * hints. Called once the frame content is complete, under the shard latch of the page.
+   */
+  void PublishFrame(frame_id_t frame_id, page_id_t page_id);
+
+  /** @return the location hint slot of page_id */
+  auto LocationHint(page_id_t page_id) -> std::atomic<uint64_t> &;
+
+  /**
+   * Unswizzle frame_id: make PinSwizzled on it fail until the next PublishFrame. Called before the page in the frame
+   * is removed, under the shard latch of the page.
+   * @return false if the frame is swizzle-pinned, the page must then stay in the frame
+   */
+  auto LockSwizzlePins(frame_id_t frame_id) -> bool;
+
+  /** Lock latch_, counting the time spent waiting for it if it is contended. */
+  auto LockLatch() -> std::unique_lock<std::mutex>;
+
+  /** @return the page table shard responsible for page_id */
+  auto GetShard(page_id_t page_id) -> PageTableShard &;
+
+  /**
+   * Pin a page if it is already resident. Only takes the shard latch of page_id, and waits on the frame if the page
+   * is still being loaded or evicted.
+   * @param page_id id of page to be pinned
+   * @return the pinned page, or nullptr if the page is not in the buffer pool or loading it failed
+   */
+  auto PinResident(page_id_t page_id) -> Page *;
+
+  /**
+   * Return a frame that was taken by GetFrame() but not used to the free list.
+   * @param frame_id the unused frame
+   */
+  void ReleaseFrame(frame_id_t frame_id);
+
+  // 获取一个不在页表中的空闲页框，函数内部加锁，脏页写回时不持有latch_
   frame_id_t GetFrame();
 
+  /**
+   * Evict page_id from frame_id so that the frame can be reused. The caller must hold latch_ (through lock) and must
+   * own the right to evict the frame, i.e. have taken it out of the replacer or from a scan ring. latch_ is released
+   * while a dirty page is written back.
+   * @param frame_id the frame to evict
+   * @param page_id the page expected in the frame
+   * @param lock the caller's lock on latch_
+   * @param unlisted true if the caller took the frame out of the replacer with Victim, so that a frame that cannot be
+   * evicted is put back into the replacer
+   * @return true if the frame is now detached from the page table, false if the page is in use (or already gone) or
+   * its write-back failed, in which case the page stays resident and dirty
+   */
+  auto EvictFrame(frame_id_t frame_id, page_id_t page_id, std::unique_lock<std::mutex> *lock, bool unlisted) -> bool;
+
+  /**
+   * Empty a frame that is being removed by ResizePool: move its page to a free frame, or evict it if there is none.
+   * The caller must hold latch_ (through lock), which may be released while a dirty page is written back.
+   * @return false if the frame holds a pinned page or a page with I/O in progress, or is owned by another thread
+   */
+  auto VacateFrame(frame_id_t frame_id, std::unique_lock<std::mutex> *lock) -> bool;
+
+  /** Record that a frame being removed by ResizePool is empty. The caller must hold latch_. */
+  void RetireFrame(frame_id_t frame_id);
+
+  /**
+   * Get a frame for a miss of a sequential scan, recycling the oldest frame of the scan's ring in this instance once
+   * the ring is full. Falls back to GetFrame() when the ring frame is in use.
+   * @param ring the active scan ring of the calling thread
+   * @return the frame, or NUMLL_FRAME if none is available
+   */
+  auto GetScanFrame(ScanRing *ring) -> frame_id_t;
+
+  /**
+   * Remember that the scan filled frame_id with page_id.
+   * @param ring the active scan ring of the calling thread
+   */
+  void RecordScanFrame(ScanRing *ring, frame_id_t frame_id, page_id_t page_id);
+
+  /**
+   * Start writing back page_id from frame_id if it is still resident there and mode asks for it: mark the frame
+   * FLUSHING and copy the page into buffer. The page stays resident, finish with EndFlush.
+   *
+   * An unpinned page is copied under the shard latch with its swizzle pins locked, nobody can be modifying it. A
+   * pinned page is copied under its read latch, which is taken before the frame is marked FLUSHING. A thread holding
+   * the write latch may wait for a FLUSHING page (DeletePage, FlushPage), so the caller must not have other write-backs
+   * started while it blocks on a latch.
+   * @param mode which pages are written
+   * @param buffer PAGE_SIZE bytes receiving the page content
+   * @param may_latch whether the caller has no write-backs started and may block on the page's read latch
+   */
+  auto BeginFlush(frame_id_t frame_id, page_id_t page_id, FlushMode mode, char *buffer, bool may_latch)
+      -> FlushStart;
+
+  /**
+   * Finish a write-back started with BeginFlush.
+   * @param ok false if the write failed, the page is then marked dirty again
+   */
+  void EndFlush(frame_id_t frame_id, page_id_t page_id, bool ok);
+
+  /**
+   * Submit the write-backs started with BeginFlush together and wait for them, then EndFlush all of them. Adjacent
+   * entries of batch with consecutive page ids are written as one request.
+   * @param batch the pages, batch[i] was copied to buffers->At(i)
+   * @return false if any of the writes failed
+   */
+  auto WriteFlushBatch(const std::vector<std::pair<page_id_t, frame_id_t>> &batch, AlignedPageBuffer *buffers) -> bool;
+
+  /**
+   * Write back page_id from frame_id: wait for in-flight I/O on the page first, then write it if it is still resident
+   * there and mode asks for it. No latch is held during the write.
+   * @return true if the page was written successfully
+   */
+  auto FlushFrame(frame_id_t frame_id, page_id_t page_id, FlushMode mode) -> bool;
+
+  /**
+   * Publish frame_id as LOADING for page_id with a pin count of 1, the caller then fills the frame and calls
+   * FinishLoad. If the page became resident in the meantime the frame is released instead.
+   * @param[out] persisted false if the page was never written to disk and must be zero-filled instead of read
+   * @return false if the page is already resident
+   */
+  auto StartLoad(frame_id_t frame_id, page_id_t page_id, bool *persisted) -> bool;
+
+  /**
+   * Mark a frame filled after StartLoad and wake up the threads waiting for it. If the load failed, the page is
+   * removed from the page table and the loader's pin is dropped; the last thread to drop its pin releases the frame.
+   * @param ok whether the page was read successfully
+   * @return ok
+   */
+  auto FinishLoad(frame_id_t frame_id, page_id_t page_id, bool ok) -> bool;
+
+  /**
+   * One round of the background flusher.
+   * @param pages_per_round maximum number of pages to write
+   * @param dirty_watermark only write if more than this fraction of the frames is dirty
+   */
+  void BackgroundFlushRound(size_t pages_per_round, double dirty_watermark);
+
+  /** @return true if page_id belongs to this instance and has been allocated */
+  auto IsAllocatedHere(page_id_t page_id) const -> bool;
+
+  /**
+   * Queue a prefetch request, starting the prefetch threads on first use.
+   * @param scan the request comes from PrefetchScanPage
+   * @return false if the request was dropped because the queue is full
+   */
+  auto EnqueuePrefetch(page_id_t page_id, bool scan) -> bool;
+
+  /**
+   * Read the pages into the buffer pool unpinned, if not resident yet, submitting their reads together. Runs on a
+   * prefetch thread, or the warm-up thread.
+   * @param scan read the pages into the frames of prefetch_ring_ instead of evicting through the replacer
+   * @param wait wait until the reads completed
+   */
+  void PrefetchPgImp(const std::vector<page_id_t> &page_ids, bool scan = false, bool wait = false);
+
+  /** Load page_ids, sorted, in batches while there are free frames. Body of WarmUp. */
+  void WarmUpPages(const std::vector<page_id_t> &page_ids);
+
+  /** @return how many queued prefetch requests a prefetch thread handles at once */
+  auto PrefetchBatchSize() const -> size_t;
+
+  /** Stop and join the prefetch threads, pending requests are dropped. Called by the destructor. */
+  void StopPrefetchers();
+
   static const frame_id_t NUMLL_FRAME = -1;
-  /** Number of pages in the buffer pool. */
-  const size_t pool_size_;
+  /** Number of page table shards, page ids of this BPI are spread over the shards round robin. */
+  static constexpr size_t PAGE_TABLE_SHARD_COUNT = 16;
+  /** The background flusher looks at this many times pages_per_round frames from the tail of the replacer. */
+  static constexpr size_t BACKGROUND_FLUSH_LOOKAHEAD = 4;
+  /** Number of prefetch threads of each instance. */
+  static constexpr size_t PREFETCH_THREAD_COUNT = 2;
+  /** Maximum number of pending prefetch requests, further requests are dropped. */
+  static constexpr size_t PREFETCH_QUEUE_CAPACITY = 64;
+  /** Maximum number of prefetch reads a prefetch thread submits together. */
+  static constexpr size_t PREFETCH_BATCH_SIZE = 8;
+  /** Number of pages WarmUp reads together. */
+  static constexpr size_t WARM_UP_BATCH_SIZE = DISK_IO_QUEUE_DEPTH;
+  /** First word of a DumpResidentPages file. */
+  static constexpr uint32_t WARM_UP_FILE_MAGIC = 0x55575042;  // "BPWU"
+  /** Number of pages FlushAllPages writes back together. */
+  static constexpr size_t FLUSH_BATCH_SIZE = DISK_IO_QUEUE_DEPTH;
+  /** Each thread reports one in this many of its swizzled pins to the replacer as a reference. */
+  static constexpr uint32_t SWIZZLE_REFERENCE_SAMPLE_RATE = 8;
+  /** Number of pages in the buffer pool, frames [pool_size_, max_pool_size_) are not used. Changed under latch_. */
+  std::atomic<size_t> pool_size_;
+  /** Number of frames reserved in frame_arena_. */
+  const size_t max_pool_size_;
   /** How many instances are in the parallel BPM (if present, otherwise just 1 BPI) */
   const uint32_t num_instances_ = 1;
   /** Index of this BPI in the parallel BPM (if present, otherwise just 0) */
@@ -134,19 +572,107 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** Each BPI maintains its own counter for page_ids to hand out, must ensure they mod back to its instance_index_ */
   std::atomic<page_id_t> next_page_id_ = instance_index_;
 
-  /** Array of buffer pool pages. */
-  Page *pages_;
+  /** Memory of the buffer pool pages. */
+  std::unique_ptr<FrameArena> frame_arena_;
+  /** I/O state of each frame, protected by the shard latch of the page held in the frame. */
+  std::vector<FrameIOState> frame_io_;
+  /**
+   * Page held by each frame, INVALID_PAGE_ID if none. Mirrors page_id_ so that it can be read without owning the
+   * frame; always re-check against the page table before using it.
+   */
+  std::vector<std::atomic<page_id_t>> frame_page_ids_;
+  /** Number of dirty frames. */
+  std::atomic<size_t> num_dirty_{0};
+  /**
+   * Seqlock version of each frame: odd while the frame holds no readable page or is being modified, incremented
+   * whenever the page in it changes. See OptimisticPageReader.
+   */
+  std::vector<std::atomic<uint64_t>> frame_versions_;
+  /**
+   * Direct-mapped page_id -> frame_id hints for TryOptimisticRead, packed as page_id << 32 | frame_id. A hint may be
+   * stale or overwritten by another page, readers check it against frame_page_ids_ and frame_versions_.
+   */
+  std::vector<std::atomic<uint64_t>> location_hints_;
+  /**
+   * Number of PinSwizzled pins of each frame. Frames not holding a published page are locked by adding
+   * SWIZZLE_PINS_LOCKED, which keeps the count negative; see LockSwizzlePins.
+   */
+  std::vector<std::atomic<int32_t>> swizzle_pins_;
+  static constexpr int32_t SWIZZLE_PINS_LOCKED = INT32_MIN / 2;
+  /**
+   * Frames Victim took out of the replacer whose eviction was given up because they were being flushed. EndFlush puts
+   * them back into the replacer if they are still unpinned. Protected by the shard latch of the page.
+   */
+  std::vector<uint8_t> frame_unlisted_;
+  /** Buffer hits on the page held by each frame, protected by the shard latch of the page. */
+  std::vector<uint64_t> frame_fetches_;
+  /** Statistics, see GetStats(). */
+  BufferPoolCounters stats_;
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
+  /** Page I/O backend, all page reads and writes go through it. */
+  std::unique_ptr<DiskIO> disk_io_;
   /** Pointer to the log manager. */
   LogManager *log_manager_ __attribute__((__unused__));
-  /** Page table for keeping track of buffer pool pages. */
-  std::unordered_map<page_id_t, frame_id_t> page_table_;
+  /** Page table for keeping track of buffer pool pages, sharded by page id. */
+  std::array<PageTableShard, PAGE_TABLE_SHARD_COUNT> page_table_;
   /** Replacer to find unpinned pages for replacement. */
-  Replacer *replacer_;
+  PeekableReplacer *replacer_;
   /** List of free pages. */
   std::list<frame_id_t> free_list_;
-  /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
+  /** Size of free_list_, readable without latch_. */
+  std::atomic<size_t> num_free_frames_{0};
+  /**
+   * This latch protects free_list_ and serializes taking frames out of the replacer with DeletePage. It is only taken
+   * briefly on a miss, NewPage and DeletePage, never on a buffer hit and never across disk I/O. Lock order is latch_
+   * before any page table shard latch.
+   */
   std::mutex latch_;
+  /**
+   * While ResizePool shrinks the pool, the removed frames still in use. Frames with an id of at least pool_size_ are
+   * retired instead of reused when they are released. Protected by latch_.
+   */
+  std::vector<bool> frame_retiring_;
+  size_t num_retiring_{0};
+  /** Signalled when a retiring frame becomes empty. */
+  std::condition_variable retired_cv_;
+  /** Serializes ResizePool calls. */
+  std::mutex resize_mutex_;
+
+  /** Background flusher thread, see StartBackgroundFlusher(). */
+  std::thread flusher_;
+  /** Protects flusher_running_, used to wake the flusher up when it is stopped. */
+  std::mutex flusher_mutex_;
+  std::condition_variable flusher_cv_;
+  bool flusher_running_{false};
+
+  /** Prefetch threads, started by the first prefetch request. */
+  std::vector<std::thread> prefetchers_;
+  /** A pending prefetch request. */
+  struct PrefetchRequest {
+    page_id_t page_id_;
+    /** requested by a sequential scan, see PrefetchScanPage */
+    bool scan_;
+  };
+  /** Pending prefetch requests. */
+  std::deque<PrefetchRequest> prefetch_queue_;
+  /** Protects prefetchers_, prefetch_queue_ and prefetch_stopped_. */
+  std::mutex prefetch_mutex_;
+  std::condition_variable prefetch_cv_;
+  bool prefetch_stopped_{false};
+  /** Frames recycled by the prefetch reads of scans, shared by the prefetch threads. */
+  ScanRing prefetch_ring_;
+  /** Serializes the prefetch threads' use of prefetch_ring_, taken before latch_. */
+  std::mutex prefetch_ring_mutex_;
+
+  /** Background WarmUp thread. */
+  std::thread warm_up_thread_;
+  std::atomic<bool> warm_up_stopped_{false};
+  /** Periodic DumpResidentPages thread, see StartWarmUpDumps(). */
+  std::thread dump_thread_;
+  /** Protects dump_running_, used to wake the dump thread up when it is stopped. */
+  std::mutex dump_mutex_;
+  std::condition_variable dump_cv_;
+  bool dump_running_{false};
 };
 }  // namespace bustub
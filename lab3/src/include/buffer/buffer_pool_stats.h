@@ -0,0 +1,178 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_stats.h
+//
+// Identification: src/include/buffer/buffer_pool_stats.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/** Number of buckets of a latency histogram. */
+static constexpr size_t LATENCY_BUCKET_COUNT = 32;
+/** Number of stripes of a StripedCounter. */
+static constexpr size_t COUNTER_STRIPE_COUNT = 16;
+
+/**
+ * Snapshot of a LatencyHistogram. Bucket 0 counts latencies below 1us, bucket i > 0 counts latencies in
+ * [2^(i-1), 2^i) us; the last bucket also counts everything above.
+ */
+struct LatencyHistogramSnapshot {
+  std::array<uint64_t, LATENCY_BUCKET_COUNT> buckets_{};
+  /** Number of recorded latencies. */
+  uint64_t count_{0};
+  /** Sum of the recorded latencies. */
+  uint64_t total_ns_{0};
+
+  /** @return mean latency in microseconds, 0 if nothing was recorded */
+  auto MeanMicros() const -> double;
+
+  /**
+   * @param fraction percentile as a fraction in [0, 1], e.g. 0.99
+   * @return upper bound in microseconds of the bucket holding the percentile, 0 if nothing was recorded
+   */
+  auto PercentileMicros(double fraction) const -> uint64_t;
+
+  auto operator+=(const LatencyHistogramSnapshot &other) -> LatencyHistogramSnapshot &;
+};
+
+/**
+ * LatencyHistogram records latencies into power-of-two microsecond buckets with relaxed atomic increments, so it
+ * can be updated concurrently without a latch.
+ */
+class LatencyHistogram {
+ public:
+  /** Record one latency. */
+  void Record(std::chrono::nanoseconds latency);
+
+  /** @return the current counts, not an atomic snapshot across buckets */
+  auto Snapshot() const -> LatencyHistogramSnapshot;
+
+  /** Reset all counts to 0. */
+  void Reset();
+
+ private:
+  std::array<std::atomic<uint64_t>, LATENCY_BUCKET_COUNT> buckets_{};
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_ns_{0};
+};
+
+/**
+ * StripedCounter is a counter bumped by many threads at once on hot paths. Every thread adds to one of several
+ * stripes, each on its own cache line, so that concurrent hits do not bounce a single line between cores; reading
+ * sums the stripes up.
+ */
+class StripedCounter {
+ public:
+  /** Add n to the stripe of the calling thread. */
+  void Add(uint64_t n) { stripes_[ThreadStripe()].value_.fetch_add(n, std::memory_order_relaxed); }
+
+  /** @return the sum of all stripes, not an atomic snapshot */
+  auto Load() const -> uint64_t;
+
+  /** Reset all stripes to 0. */
+  void Reset();
+
+ private:
+  struct alignas(64) Stripe {
+    std::atomic<uint64_t> value_{0};
+  };
+
+  /** @return the stripe of the calling thread, threads are assigned round-robin when they first count */
+  static auto ThreadStripe() -> size_t {
+    static std::atomic<size_t> next_stripe{0};
+    thread_local size_t stripe = next_stripe.fetch_add(1, std::memory_order_relaxed) % COUNTER_STRIPE_COUNT;
+    return stripe;
+  }
+
+  std::array<Stripe, COUNTER_STRIPE_COUNT> stripes_{};
+};
+
+/**
+ * Snapshot of the statistics of a buffer pool, see BufferPoolManagerInstance::GetStats. Snapshots of several
+ * instances are summed up with +=.
+ */
+struct BufferPoolStats {
+  /** FetchPage calls that found the page resident. */
+  uint64_t fetch_hits_{0};
+  /** FetchPage calls that read the page into the buffer pool. */
+  uint64_t fetch_misses_{0};
+  /** Pages evicted to make room for another page. */
+  uint64_t evictions_{0};
+  /** Evictions that had to write the page back first. */
+  uint64_t dirty_evictions_{0};
+  /** Pages written back while staying resident, by FlushPage, FlushAllPages or the background flusher. */
+  uint64_t flushed_pages_{0};
+  /** Pages read ahead by the prefetch threads. */
+  uint64_t prefetched_pages_{0};
+  /** Successful NewPage calls. */
+  uint64_t new_pages_{0};
+  /** Successful DeletePage calls. */
+  uint64_t deleted_pages_{0};
+  /** Number of times the instance latch was contended. */
+  uint64_t latch_waits_{0};
+  /** Total time spent waiting for the instance latch. */
+  uint64_t latch_wait_ns_{0};
+  /** Latency of page reads. */
+  LatencyHistogramSnapshot read_latency_;
+  /** Latency of page writes; pages written in one batch all count the latency of the batch. */
+  LatencyHistogramSnapshot write_latency_;
+
+  /** @return fetch_hits_ / (fetch_hits_ + fetch_misses_), 0 if there were no fetches */
+  auto HitRate() const -> double;
+
+  auto operator+=(const BufferPoolStats &other) -> BufferPoolStats &;
+};
+
+/** Access count of a resident page, see BufferPoolManagerInstance::GetHottestPages. */
+struct PageHeat {
+  page_id_t page_id_;
+  /** Number of buffer hits on the page since it was last read into the buffer pool. */
+  uint64_t fetches_;
+};
+
+/**
+ * BufferPoolCounters are the live counters behind BufferPoolStats. All of them are updated with relaxed atomic
+ * increments; the fetch counters, updated on every FetchPage and swizzled pin, are striped per thread.
+ */
+struct BufferPoolCounters {
+  StripedCounter fetch_hits_;
+  StripedCounter fetch_misses_;
+  alignas(64) std::atomic<uint64_t> evictions_{0};
+  std::atomic<uint64_t> dirty_evictions_{0};
+  std::atomic<uint64_t> flushed_pages_{0};
+  std::atomic<uint64_t> prefetched_pages_{0};
+  std::atomic<uint64_t> new_pages_{0};
+  std::atomic<uint64_t> deleted_pages_{0};
+  std::atomic<uint64_t> latch_waits_{0};
+  std::atomic<uint64_t> latch_wait_ns_{0};
+  LatencyHistogram read_latency_;
+  LatencyHistogram write_latency_;
+
+  /** Add 1 to a counter. */
+  static void Increment(std::atomic<uint64_t> *counter) { counter->fetch_add(1, std::memory_order_relaxed); }
+
+  /** Add 1 to a striped counter. */
+  static void Increment(StripedCounter *counter) { counter->Add(1); }
+
+  /** @return the current values of the counters */
+  auto Snapshot() const -> BufferPoolStats;
+
+  /** Reset all counters to 0. */
+  void Reset();
+};
+
+}  // namespace bustub
@@ -0,0 +1,70 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// clock_replacer.h
+//
+// Identification: src/include/buffer/clock_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <mutex>  // NOLINT
+#include <vector>
+
+#include "buffer/peekable_replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * ClockReplacer implements the clock (second chance) replacement policy, which approximates LRU.
+ * Each frame owns one byte of state in a flat array, so Pin and Unpin are a single atomic bit operation and never
+ * allocate or take a latch. Only Victim, which moves the clock hand, is serialized.
+ */
+class ClockReplacer : public PeekableReplacer {
+ public:
+  /**
+   * Create a new ClockReplacer.
+   * @param num_pages the maximum number of pages the ClockReplacer will be required to store
+   */
+  explicit ClockReplacer(size_t num_pages);
+
+  /**
+   * Destroys the ClockReplacer.
+   */
+  ~ClockReplacer() override;
+
+  auto Victim(frame_id_t *frame_id) -> bool override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  auto Size() -> size_t override;
+
+  void PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) override;
+
+  void RecordReference(frame_id_t frame_id) override;
+
+ private:
+  /** The frame is unpinned and may be evicted. */
+  static constexpr uint8_t EVICTABLE = 0x1;
+  /** The frame was used since the clock hand last passed it. */
+  static constexpr uint8_t REFERENCED = 0x2;
+
+  const size_t num_pages_;
+  // 每个页框一个字节的状态位
+  std::vector<std::atomic<uint8_t>> frames_;
+  // 可淘汰的页框数；Unpin先加再置位，并发时只会暂时偏大
+  std::atomic<size_t> size_{0};
+  // 只保护时钟指针，Pin/Unpin不需要加锁
+  std::mutex hand_mutex_;
+  size_t clock_hand_{0};
+};
+
+}  // namespace bustub
@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// frame_arena.h
+//
+// Identification: src/include/buffer/frame_arena.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "common/macros.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/** Alignment of every frame with FrameArenaOptions::aligned_frames_, the one required by O_DIRECT I/O. */
+static constexpr size_t FRAME_ALIGNMENT = 4096;
+
+/** Memory placement of the frames of a buffer pool. */
+struct FrameArenaOptions {
+  /** Back the frames with 2 MiB huge pages: hugetlbfs pages if reserved, otherwise transparent huge pages. */
+  bool huge_pages_ = false;
+  /** Bind the frames to this NUMA node, -1 to use the default policy of the process. */
+  int numa_node_ = -1;
+  /**
+   * Address space to reserve, in frames, so that the arena can later grow up to this size. Reserved frames only take
+   * memory once they are in use (except hugetlbfs pages, which are reserved up front). 0 reserves the initial size.
+   */
+  size_t max_frame_count_ = 0;
+  /**
+   * Start every frame, and so its data (the first member of Page), at a FRAME_ALIGNMENT boundary, so that O_DIRECT
+   * reads and writes go straight to the frame instead of through a bounce buffer. sizeof(Page) is a little more than
+   * PAGE_SIZE, so this about doubles the memory of the frames, and the frames are no longer an array of Page.
+   */
+  bool aligned_frames_ = false;
+};
+
+/**
+ * FrameArena owns the Page frames of a buffer pool. The frames are allocated with mmap, so the arena controls the
+ * page size backing them and the NUMA node they live on, which matters for TLB misses and remote memory accesses
+ * under random page access. Without these options it behaves like new Page[frame_count].
+ */
+class FrameArena {
+ public:
+  /**
+   * Allocate and construct frame_count frames. Placement options that the system does not support are ignored.
+   * @param frame_count number of frames
+   * @param options memory placement of the frames
+   */
+  FrameArena(size_t frame_count, const FrameArenaOptions &options);
+  ~FrameArena();
+
+  DISALLOW_COPY_AND_MOVE(FrameArena);
+
+  /** @return the first frame; the frames are an array of Page only if Stride() == sizeof(Page) */
+  auto Frames() -> Page * { return reinterpret_cast<Page *>(memory_); }
+
+  /** @return the frame frame_id */
+  auto Frame(size_t frame_id) -> Page & { return *reinterpret_cast<Page *>(memory_ + frame_id * stride_); }
+
+  /** @return the id of frame page, which must be a frame of this arena */
+  auto FrameId(const Page *page) const -> size_t {
+    return (reinterpret_cast<const char *>(page) - memory_) / stride_;
+  }
+
+  /** @return distance in bytes between two consecutive frames */
+  auto Stride() const -> size_t { return stride_; }
+
+  /** @return true if the frames are backed by hugetlbfs pages */
+  auto UsesHugeTlb() const -> bool { return huge_tlb_; }
+
+  /** @return number of constructed frames */
+  auto FrameCount() const -> size_t { return frame_count_; }
+
+  /** @return number of frames the arena can grow to */
+  auto Capacity() const -> size_t { return capacity_; }
+
+  /**
+   * Grow or shrink the arena to frame_count frames, keeping the address of the remaining frames. Frames added are
+   * constructed, frames removed are destroyed and their memory is returned to the system; the caller must make sure
+   * nobody uses them anymore.
+   * @param frame_count new number of frames, at most Capacity()
+   */
+  void Resize(size_t frame_count);
+
+ private:
+  /** Give the memory behind frames [frame_count, capacity_) back to the system. */
+  void ReleaseTail(size_t frame_count);
+
+  size_t frame_count_;
+  size_t capacity_;
+  /** sizeof(Page), rounded up to FRAME_ALIGNMENT with aligned_frames_. */
+  size_t stride_;
+  /** Size of the mapping, a multiple of the (huge) page size. */
+  size_t mapping_size_{0};
+  bool huge_tlb_{false};
+  char *memory_{nullptr};
+};
+
+}  // namespace bustub
@@ -0,0 +1,97 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lru_k_replacer.h
+//
+// Identification: src/include/buffer/lru_k_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <mutex>  // NOLINT
+#include <set>
+#include <tuple>
+#include <vector>
+
+#include "buffer/peekable_replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/** Default K of LRUKReplacer. */
+static constexpr size_t LRUK_REPLACER_K = 2;
+
+/**
+ * LRUKReplacer implements the LRU-K replacement policy.
+ *
+ * The backward k-distance of a frame is the difference between the current timestamp and the timestamp of its k-th
+ * most recent access. Victim evicts the evictable frame with the largest backward k-distance. Frames with fewer than
+ * k recorded accesses have +inf distance and are evicted first, oldest first access first, so pages touched once by
+ * a sequential scan leave before the hot set.
+ *
+ * An access is recorded each time the last pin of a frame is released (Unpin), so overlapping pins of a frame by
+ * several threads count as one correlated reference. A frame handed out by Victim and put back with Unpin without
+ * being pinned in between was not accessed, so no access is recorded for it. The history of a frame is discarded by
+ * ResetHistory when the frame starts holding another page. The evictable frames are kept ordered by their backward
+ * k-distance, so Victim takes O(log n).
+ */
+class LRUKReplacer : public PeekableReplacer {
+ public:
+  /**
+   * Create a new LRUKReplacer.
+   * @param num_pages the maximum number of pages the LRUKReplacer will be required to store
+   * @param k the number of accesses tracked per frame
+   */
+  explicit LRUKReplacer(size_t num_pages, size_t k = LRUK_REPLACER_K);
+
+  /**
+   * Destroys the LRUKReplacer.
+   */
+  ~LRUKReplacer() override;
+
+  auto Victim(frame_id_t *frame_id) -> bool override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  auto Size() -> size_t override;
+
+  void PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) override;
+
+  void RecordReference(frame_id_t frame_id) override;
+
+  void ResetHistory(frame_id_t frame_id) override;
+
+ private:
+  /** (finite distance, timestamp, frame): ordering by it evicts +inf first, then the earliest timestamp first. */
+  using EvictionKey = std::tuple<bool, size_t, frame_id_t>;
+
+  /** Record an access of frame_id at the current timestamp. */
+  void RecordAccess(frame_id_t frame_id);
+
+  /** @return the position of frame_id in the eviction order, computed from its current history */
+  auto GetEvictionKey(frame_id_t frame_id) const -> EvictionKey;
+
+  const size_t num_pages_;
+  const size_t k_;
+  std::mutex mutex_;
+  size_t current_timestamp_{0};
+  size_t size_{0};
+  // 每个页框最近k次访问的时间戳，按环形缓冲区存放在一个连续数组中，避免分配
+  std::vector<size_t> history_;
+  // 每个页框已记录的访问次数（最多记录到k次）以及环形缓冲区下一个写入位置
+  std::vector<size_t> access_count_;
+  std::vector<size_t> history_head_;
+  std::vector<bool> evictable_;
+  // 被Victim取出后还没有被pin过的页框，放回时不算一次访问
+  std::vector<bool> victimized_;
+  // 可淘汰的页框，按淘汰顺序排列；页框在其中时访问历史不会改变，键保持不变
+  std::set<EvictionKey> eviction_order_;
+};
+
+}  // namespace bustub
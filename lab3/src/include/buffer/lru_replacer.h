@@ -17,7 +17,7 @@
 #include <unordered_map>
 #include <vector>
 
-#include "buffer/replacer.h"
+#include "buffer/peekable_replacer.h"
 #include "common/config.h"
 
 namespace bustub {
@@ -25,7 +25,7 @@ namespace bustub {
 /**
  * LRUReplacer implements the Least Recently Used replacement policy.
  */
-class LRUReplacer : public Replacer {
+class LRUReplacer : public PeekableReplacer {
  public:
   /**
    * Create a new LRUReplacer.
@@ -46,6 +46,10 @@ class LRUReplacer : public Replacer {
 
   auto Size() -> size_t override;
 
+  void PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) override;
+
+  void RecordReference(frame_id_t frame_id) override;
+
  private:
   // TODO(student): implement me!
   std::mutex mutex_;
@@ -0,0 +1,88 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// optimistic_page_reader.h
+//
+// Identification: src/include/buffer/optimistic_page_reader.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * OptimisticRead is a read of a resident page without pin or latch. The page may be modified, evicted or replaced
+ * while it is read, so the content read is only meaningful if Validate() returns true afterwards. Code reading it
+ * must not trust anything it reads before validating, e.g. it must bound loops by constants of the page layout.
+ */
+class OptimisticRead {
+ public:
+  OptimisticRead() = default;
+  OptimisticRead(const char *data, const std::atomic<uint64_t> *version, uint64_t version_seen)
+      : data_(data), version_(version), version_seen_(version_seen) {}
+
+  /** @return the page content, PAGE_SIZE bytes */
+  auto GetData() const -> const char * { return data_; }
+
+  /** @return true if the page was neither modified nor replaced since the read started */
+  auto Validate() const -> bool {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_->load(std::memory_order_relaxed) == version_seen_;
+  }
+
+ private:
+  const char *data_{nullptr};
+  const std::atomic<uint64_t> *version_{nullptr};
+  uint64_t version_seen_{0};
+};
+
+/**
+ * OptimisticPageReader is implemented by buffer pools whose frames carry a version counter (a seqlock): it is odd
+ * while the frame is being modified or holds no page, and changes whenever the page in the frame changes. Readers
+ * start an OptimisticRead and validate it afterwards, so a read-only probe of a hot page writes no shared cache line.
+ *
+ * Writers of pages that are read optimistically must bracket their modifications with BeginPageWrite and EndPageWrite
+ * while holding the page write latch.
+ *
+ * Callers only holding a BufferPoolManager pointer reach it through FromBufferPool.
+ */
+class OptimisticPageReader {
+ public:
+  virtual ~OptimisticPageReader() = default;
+
+  /**
+   * Start an optimistic read of a page.
+   * @param page_id id of the page to be read
+   * @param[out] read the read, to be validated after the page content was read
+   * @return false if the page is not resident or is being modified, the caller then falls back to FetchPage
+   */
+  virtual auto TryOptimisticRead(page_id_t page_id, OptimisticRead *read) -> bool = 0;
+
+  /**
+   * Mark a pinned page as being modified, so that concurrent optimistic reads of it fail validation. The caller must
+   * hold the write latch of the page until EndPageWrite.
+   * @param page the page
+   */
+  virtual void BeginPageWrite(Page *page) = 0;
+
+  /** Finish a modification started with BeginPageWrite. */
+  virtual void EndPageWrite(Page *page) = 0;
+
+  /** @return the optimistic read interface of bpm, nullptr if it does not support optimistic reads */
+  static auto FromBufferPool(BufferPoolManager *bpm) -> OptimisticPageReader * {
+    return dynamic_cast<OptimisticPageReader *>(bpm);
+  }
+};
+
+}  // namespace bustub
@@ -0,0 +1,60 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_prefetcher.h
+//
+// Identification: src/include/buffer/page_prefetcher.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * PagePrefetcher is implemented by buffer pools that can read pages ahead of use. Prefetched pages are read by
+ * background I/O threads and installed unpinned, a later FetchPage of the page is then a buffer hit.
+ *
+ * Callers only holding a BufferPoolManager pointer reach it through FromBufferPool; prefetching is a hint, requests
+ * may be dropped at any time.
+ */
+class PagePrefetcher {
+ public:
+  virtual ~PagePrefetcher() = default;
+
+  /**
+   * Schedule an asynchronous read of a page. Does nothing if the page is already resident.
+   * @param page_id id of page to be prefetched
+   */
+  virtual void PrefetchPage(page_id_t page_id) = 0;
+
+  /**
+   * Schedule an asynchronous read of a page a sequential scan reads next. Like a miss of a scan (see ScanRing), the
+   * page is read into a small ring of frames recycled by such reads, so read-ahead of scans does not evict the working
+   * set of the buffer pool.
+   * @param page_id id of page to be prefetched
+   */
+  virtual void PrefetchScanPage(page_id_t page_id) = 0;
+
+  /**
+   * Schedule asynchronous reads of pages [first_page_id, first_page_id + count).
+   * @param first_page_id id of the first page to be prefetched
+   * @param count number of pages
+   */
+  virtual void PrefetchRange(page_id_t first_page_id, size_t count) = 0;
+
+  /** @return the prefetch interface of bpm, nullptr if it does not support prefetching */
+  static auto FromBufferPool(BufferPoolManager *bpm) -> PagePrefetcher * {
+    return dynamic_cast<PagePrefetcher *>(bpm);
+  }
+};
+
+}  // namespace bustub
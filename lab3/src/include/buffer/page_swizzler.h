@@ -0,0 +1,55 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_swizzler.h
+//
+// Identification: src/include/buffer/page_swizzler.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/config.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+/**
+ * PageSwizzler is implemented by buffer pools that let callers keep swizzled references to pages: the Page pointer
+ * returned by FetchPage, kept after the page was unpinned. Pinning through a swizzled reference goes straight to the
+ * frame, without looking the page up in the page table and without taking a latch.
+ *
+ * A swizzled reference is never dangling: it keeps pointing to a frame of the buffer pool, which may meanwhile hold
+ * another page. Evicting or deleting a page unswizzles all references to it at once, PinSwizzled then fails and the
+ * caller falls back to FetchPage and swizzles the page it returns.
+ *
+ * Callers only holding a BufferPoolManager pointer reach it through FromBufferPool.
+ */
+class PageSwizzler {
+ public:
+  virtual ~PageSwizzler() = default;
+
+  /**
+   * Pin a page through a swizzled reference.
+   * @param page a Page pointer once returned by FetchPage or NewPage for page_id
+   * @param page_id id of the page the reference was swizzled for
+   * @return false if the frame no longer holds page_id, the reference must then be dropped
+   */
+  virtual auto PinSwizzled(Page *page, page_id_t page_id) -> bool = 0;
+
+  /**
+   * Unpin a page pinned with PinSwizzled.
+   * @param page the page
+   * @param is_dirty true if the page was modified
+   */
+  virtual void UnpinSwizzled(Page *page, bool is_dirty) = 0;
+
+  /** @return the swizzling interface of bpm, nullptr if it does not support swizzled references */
+  static auto FromBufferPool(BufferPoolManager *bpm) -> PageSwizzler * { return dynamic_cast<PageSwizzler *>(bpm); }
+};
+
+}  // namespace bustub
@@ -0,0 +1,129 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// partitioned_lru_replacer.h
+//
+// Identification: src/include/buffer/partitioned_lru_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "buffer/peekable_replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/** Default number of partitions of a PartitionedLRUReplacer. */
+static constexpr size_t PARTITIONED_LRU_PARTITIONS = 16;
+
+/**
+ * PartitionedLRUReplacer approximates LRU with independently latched partitions, so that threads pinning and
+ * unpinning different frames do not contend on one latch and one list.
+ *
+ * Frame f belongs to partition f % num_partitions, which keeps its evictable frames in an intrusive LRU list. Victim
+ * evicts the tail of the partition whose tail was unpinned longest ago, which is the global LRU frame up to the
+ * unpins still buffered.
+ *
+ * Unpin only appends the frame to a small per-thread buffer, which is moved into the partitions in batches of
+ * UNPIN_BATCH_SIZE, one latch acquisition per partition. A frame pinned again while its unpin is buffered is dropped
+ * from the batch. Buffered unpins are invisible to Victim until it finds all partitions empty and drains the buffers
+ * of all threads, so they are treated as the most recently used frames.
+ */
+class PartitionedLRUReplacer : public PeekableReplacer {
+ public:
+  /**
+   * Create a new PartitionedLRUReplacer.
+   * @param num_pages the maximum number of pages the PartitionedLRUReplacer will be required to store
+   * @param num_partitions number of independently latched partitions
+   */
+  explicit PartitionedLRUReplacer(size_t num_pages, size_t num_partitions = PARTITIONED_LRU_PARTITIONS);
+
+  /**
+   * Destroys the PartitionedLRUReplacer.
+   */
+  ~PartitionedLRUReplacer() override;
+
+  auto Victim(frame_id_t *frame_id) -> bool override;
+
+  void Pin(frame_id_t frame_id) override;
+
+  void Unpin(frame_id_t frame_id) override;
+
+  /**
+   * @return the approximate number of evictable frames, counting the buffered unpins; does not drain the buffers,
+   * so a buffered unpin of a frame pinned again is counted until Victim or PeekVictims drains it
+   */
+  auto Size() -> size_t override;
+
+  void PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) override;
+
+  void RecordReference(frame_id_t frame_id) override;
+
+ private:
+  /** Number of unpins a thread buffers before moving them into the partitions. */
+  static constexpr size_t UNPIN_BATCH_SIZE = 8;
+  /** Number of unpin buffers, threads beyond it share buffers. */
+  static constexpr size_t UNPIN_BUFFER_COUNT = 64;
+  static constexpr frame_id_t NO_FRAME = -1;
+
+  /** One LRU list, head is the most recently unpinned frame. */
+  struct alignas(64) Partition {
+    std::mutex latch_;
+    frame_id_t head_{NO_FRAME};
+    frame_id_t tail_{NO_FRAME};
+    std::atomic<size_t> size_{0};
+    /** Unpin stamp of the tail, UINT64_MAX if the list is empty; read by Victim without the latch. */
+    std::atomic<uint64_t> oldest_{UINT64_MAX};
+  };
+
+  /** Unpins (frame, pin sequence at the time of the unpin) not yet moved into the partitions. */
+  struct alignas(64) UnpinBuffer {
+    std::mutex latch_;
+    std::vector<std::pair<frame_id_t, uint32_t>> entries_;
+    /** Size of entries_, read by Size without the latch. */
+    std::atomic<size_t> size_{0};
+  };
+
+  auto GetPartition(frame_id_t frame_id) -> Partition & { return partitions_[frame_id % partitions_.size()]; }
+
+  /** @return the unpin buffer of the calling thread */
+  auto ThreadBuffer() -> UnpinBuffer &;
+
+  /** Move a batch of unpins into the partitions, skipping frames pinned since; holding the latch of its buffer. */
+  void FlushUnpins(std::vector<std::pair<frame_id_t, uint32_t>> *entries);
+
+  /** Move the buffered unpins of all threads into the partitions. */
+  void DrainUnpinBuffers();
+
+  /** Link frame_id at the head of partition, holding its latch. */
+  void PushFront(Partition *partition, frame_id_t frame_id, uint64_t stamp);
+
+  /** Unlink frame_id from partition, holding its latch; the caller updates listed_. */
+  void Remove(Partition *partition, frame_id_t frame_id);
+
+  const size_t num_pages_;
+  std::vector<Partition> partitions_;
+  std::vector<UnpinBuffer> unpin_buffers_;
+  // 每个页框在分区链表中的前后指针和放回时的时间戳，由所在分区的锁保护
+  std::vector<frame_id_t> prev_;
+  std::vector<frame_id_t> next_;
+  std::vector<uint64_t> stamps_;
+  /** Whether each frame is linked in its partition, read by Pin without the latch. */
+  std::vector<std::atomic<bool>> listed_;
+  /** Incremented by every Pin, so that batched unpins can tell the frame was pinned again. */
+  std::vector<std::atomic<uint32_t>> pin_seqs_;
+  /** Unpin stamp source, advanced once per batch. */
+  std::atomic<uint64_t> clock_{0};
+};
+
+}  // namespace bustub
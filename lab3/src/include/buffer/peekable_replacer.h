@@ -0,0 +1,50 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// peekable_replacer.h
+//
+// Identification: src/include/buffer/peekable_replacer.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <vector>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace bustub {
+
+/**
+ * PeekableReplacer is a Replacer that can also report which frames it would evict next, without evicting them.
+ * The buffer pool uses it to clean frames before they reach the tail of the replacer.
+ */
+class PeekableReplacer : public Replacer {
+ public:
+  /**
+   * Collect up to max_frames evictable frames, in the order Victim would (approximately) return them.
+   * @param max_frames maximum number of frames to collect
+   * @param[out] frames the frames, next victim first
+   */
+  virtual void PeekVictims(size_t max_frames, std::vector<frame_id_t> *frames) = 0;
+
+  /**
+   * Forget what the replacer remembers about the accesses of frame_id. Called when the frame starts holding another
+   * page, so the new page does not inherit the access history of the old one.
+   * @param frame_id the frame that now holds another page
+   */
+  virtual void ResetHistory(frame_id_t frame_id) {}
+
+  /**
+   * Record an access to frame_id made without pinning it, e.g. through a swizzled reference. If the frame is
+   * evictable, it moves away from the victim end as if it had just been unpinned; otherwise nothing happens.
+   * @param frame_id the frame that was accessed
+   */
+  virtual void RecordReference(frame_id_t frame_id) {}
+};
+
+}  // namespace bustub
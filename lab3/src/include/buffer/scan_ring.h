@@ -0,0 +1,85 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// scan_ring.h
+//
+// Identification: src/include/buffer/scan_ring.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+
+namespace bustub {
+
+class BufferPoolManagerInstance;
+
+/** Default number of frames a scan ring may occupy in each BufferPoolManagerInstance. */
+static constexpr size_t SCAN_RING_SIZE = 32;
+
+/**
+ * ScanRing is an access hint for large sequential scans. While a ScanRing is active on a thread (see Guard), page
+ * misses of that thread recycle a small private ring of frames in each buffer pool instance instead of evicting
+ * through the replacer, so a scan never occupies more than ring_size frames per instance and the working set of
+ * point queries stays resident. Buffer hits are not affected.
+ *
+ * A ScanRing belongs to a single scan and must only be used by one thread at a time.
+ */
+class ScanRing {
+ public:
+  /**
+   * Create a new ScanRing.
+   * @param ring_size maximum number of frames the scan recycles in each buffer pool instance
+   */
+  explicit ScanRing(size_t ring_size = SCAN_RING_SIZE) : ring_size_(ring_size) {}
+
+  DISALLOW_COPY_AND_MOVE(ScanRing);
+
+  /**
+   * Guard makes a ScanRing the active ring of the calling thread for its lifetime.
+   */
+  class Guard {
+   public:
+    explicit Guard(ScanRing *ring) : prev_(current_) { current_ = ring; }
+    ~Guard() { current_ = prev_; }
+
+    DISALLOW_COPY_AND_MOVE(Guard);
+
+   private:
+    ScanRing *prev_;
+  };
+
+  /** @return the active ScanRing of the calling thread, nullptr if there is none */
+  static auto Current() -> ScanRing * { return current_; }
+
+ private:
+  friend class BufferPoolManagerInstance;
+
+  /** A frame recently filled by this scan, and the page it was filled with. */
+  struct Slot {
+    frame_id_t frame_id_;
+    page_id_t page_id_;
+  };
+
+  /** The ring of one buffer pool instance. */
+  struct InstanceRing {
+    std::vector<Slot> slots_;
+    /** Next slot to recycle once the ring is full. */
+    size_t next_{0};
+  };
+
+  static thread_local ScanRing *current_;
+
+  const size_t ring_size_;
+  std::unordered_map<const BufferPoolManagerInstance *, InstanceRing> rings_;
+};
+
+}  // namespace bustub
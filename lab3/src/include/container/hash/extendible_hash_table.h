@@ -12,15 +12,23 @@
 
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <memory>
 #include <queue>
 #include <string>
 #include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/optimistic_page_reader.h"
+#include "buffer/page_prefetcher.h"
+#include "buffer/page_swizzler.h"
 #include "concurrency/transaction.h"
 #include "container/hash/hash_function.h"
+#include "container/hash/hash_table_directory.h"
 #include "storage/page/hash_table_bucket_page.h"
 #include "storage/page/hash_table_directory_page.h"
+#include "storage/page/page_guard.h"
 
 namespace bustub {
 
@@ -30,6 +38,10 @@ namespace bustub {
  * Implementation of extendible hash table that is backed by a buffer pool
  * manager. Non-unique keys are supported. Supports insert and delete. The
  * table grows/shrinks dynamically as buckets become full/empty.
+ *
+ * Operations latch the directory page, then the bucket page, and release the directory as soon as the bucket is
+ * latched. Splits and merges write latch the directory only while they modify it, so operations on other buckets
+ * are blocked only briefly.
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class ExtendibleHashTable {
@@ -44,6 +56,12 @@ class ExtendibleHashTable {
   explicit ExtendibleHashTable(const std::string &name, BufferPoolManager *buffer_pool_manager,
                                const KeyComparator &comparator, HashFunction<KeyType> hash_fn);
 
+  /**
+   * Destroys the ExtendibleHashTable, deleting the bucket pages whose deletion after a merge failed because another
+   * thread still had them pinned. The buffer pool is only used if such pages are left, i.e. after concurrent merges.
+   */
+  ~ExtendibleHashTable();
+
   /**
    * Inserts a key-value pair into the hash table.
    *
@@ -74,6 +92,18 @@ class ExtendibleHashTable {
    */
   auto GetValue(Transaction *transaction, const KeyType &key, std::vector<ValueType> *result) -> bool;
 
+  /**
+   * Performs point queries of several keys. The bucket pages that are not in the buffer pool are prefetched first,
+   * so their reads overlap instead of every lookup waiting for its own read.
+   *
+   * @param transaction the current transaction
+   * @param keys the keys to look up
+   * @param[out] results results[i] receives the value(s) associated with keys[i]
+   * @return the number of keys found
+   */
+  auto GetValues(Transaction *transaction, const std::vector<KeyType> &keys,
+                 std::vector<std::vector<ValueType>> *results) -> size_t;
+
   /**
    * Returns the global depth.  Do not touch.
    */
@@ -84,6 +114,12 @@ class ExtendibleHashTable {
    */
   void VerifyIntegrity();
 
+  /**
+   * Verify the invariants of VerifyIntegrity over the whole directory, including its segment pages. VerifyIntegrity
+   * only looks at the root directory page, so it is only valid while the global depth is at most 9.
+   */
+  void VerifyDirectoryIntegrity();
+
  private:
   /**
    * Hash - simple helper to downcast MurmurHash's 64-bit hash to 32-bit
@@ -107,19 +143,19 @@ class ExtendibleHashTable {
    * representation.
    *
    * @param key the key to use for lookup
-   * @param dir_page to use for lookup of global depth
+   * @param dir to use for lookup of global depth
    * @return the directory index
    */
-  inline auto KeyToDirectoryIndex(KeyType key, HashTableDirectoryPage *dir_page) -> uint32_t;
+  inline auto KeyToDirectoryIndex(KeyType key, HashTableDirectory *dir) -> uint32_t;
 
   /**
    * Get the bucket page_id corresponding to a key.
    *
    * @param key the key for lookup
-   * @param dir_page a pointer to the hash table's directory page
+   * @param dir the hash table's directory
    * @return the bucket page_id corresponding to the input key
    */
-  inline auto KeyToPageId(KeyType key, HashTableDirectoryPage *dir_page) -> uint32_t;
+  inline auto KeyToPageId(KeyType key, HashTableDirectory *dir) -> uint32_t;
 
   /**
    * Fetches the directory page from the buffer pool manager.
@@ -132,9 +168,47 @@ class ExtendibleHashTable {
    * Fetches the a bucket page from the buffer pool manager using the bucket's page_id.
    *
    * @param bucket_page_id the page_id to fetch
-   * @return a pointer to a bucket page
+   * @return a guard holding the pin of the bucket page
+   */
+  auto FetchBucketPage(page_id_t bucket_page_id) -> BasicPageGuard;
+
+  /** Pins the root directory page for the duration of one operation. */
+  auto PinDirectoryPage() -> BasicPageGuard;
+
+  /**
+   * @param dir_page the root directory page, pinned and latched
+   * @return the whole directory, valid while dir_page is latched
    */
-  auto FetchBucketPage(page_id_t bucket_page_id) -> HASH_TABLE_BUCKET_TYPE *;
+  auto Directory(HashTableDirectoryPage *dir_page) -> HashTableDirectory;
+
+  /**
+   * Pins the bucket page of a directory slot, through the swizzled reference of the slot.
+   *
+   * @param index the directory index
+   * @param bucket_page_id the page_id of the bucket at index
+   * @return a guard holding the pin of the bucket page
+   */
+  auto PinBucketPage(uint32_t index, page_id_t bucket_page_id) -> BasicPageGuard;
+
+  /**
+   * Prefetch the bucket pages of keys that are not in the buffer pool.
+   *
+   * @param keys the keys about to be looked up
+   */
+  void PrefetchBuckets(const std::vector<KeyType> &keys);
+
+  /**
+   * Look a key up with optimistic reads of the directory, its segment page and the bucket page, without pinning or
+   * latching any of them. The directory page is validated after the bucket was read, so the bucket was the key's
+   * bucket while it was read. Gives up after a few failed validations.
+   *
+   * @param key the key to look up
+   * @param hash Hash(key)
+   * @param[out] result the value(s) associated with the key are appended
+   * @param[out] found whether the key was found
+   * @return false if a page could not be read optimistically, result is then unchanged
+   */
+  auto OptimisticGetValue(const KeyType &key, uint32_t hash, std::vector<ValueType> *result, bool *found) -> bool;
 
   /**
    * Performs insertion with an optional bucket splitting.
@@ -161,20 +235,37 @@ class ExtendibleHashTable {
    */
   void Merge(Transaction *transaction, const KeyType &key, const ValueType &value);
 
-  HashTableDirectoryPage *CreateDirectoryPage(page_id_t *bucket_page_id);
+  auto CreateDirectoryPage(page_id_t *dir_page_id) -> BasicPageGuard;
 
-  HASH_TABLE_BUCKET_TYPE *CreateBucketPage(page_id_t *bucket_page_id);
+  auto CreateBucketPage(page_id_t *bucket_page_id) -> BasicPageGuard;
 
   bool ExtraMerge(Transaction *transaction, const KeyType &key, const ValueType &value);  // 循环合并操作
 
+  /**
+   * Deletes a bucket page that is no longer referenced by the directory. A page still pinned by a thread that has
+   * just released its latch is retried by later merges. Must hold the directory write latch.
+   *
+   * @param bucket_page_id the page_id of the merged bucket
+   */
+  void DeleteBucketPage(page_id_t bucket_page_id);
+
+  /** Number of optimistic reads GetValue tries before it fetches the bucket page. */
+  static constexpr int OPTIMISTIC_READ_ATTEMPTS = 3;
+
   // member variables
   page_id_t directory_page_id_;
   BufferPoolManager *buffer_pool_manager_;
+  PagePrefetcher *prefetcher_;  // 缓冲池不支持预取时为nullptr
+  OptimisticPageReader *optimistic_reader_;  // 缓冲池不支持乐观读时为nullptr
+  PageSwizzler *swizzler_;                   // 缓冲池不支持swizzle时为nullptr
   KeyComparator comparator_;
 
-  HashTableDirectoryPage *dir_page_;  // 目录页缓存
-  // Readers includes inserts and removes, writers are splits and merges
-  ReaderWriterLatch table_latch_;
+  std::atomic<Page *> dir_ref_{nullptr};  // 目录页的swizzle引用，可能已失效，pin时由缓冲池校验
+  std::array<std::atomic<Page *>, DIRECTORY_MAX_SEGMENTS> segment_refs_{};  // 目录各段页的swizzle引用
+  // 各目录项指向的桶页的swizzle引用，可能已失效，pin时由缓冲池校验；按目录的段分配，由目录锁保护
+  using BucketRefs = std::array<std::atomic<Page *>, DIRECTORY_ARRAY_SIZE>;
+  std::vector<std::unique_ptr<BucketRefs>> bucket_refs_;
+  std::vector<page_id_t> retired_pages_;  // 合并后未能删除的桶页，由目录的写锁保护
   HashFunction<KeyType> hash_fn_;
 };
 
@@ -0,0 +1,109 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// hash_table_directory.h
+//
+// Identification: src/include/container/hash/hash_table_directory.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/page_swizzler.h"
+#include "storage/page/hash_table_directory_page.h"
+#include "storage/page/page_guard.h"
+
+namespace bustub {
+
+/**
+ * HashTableDirectory gives access to all entries of an extendible hash table directory that may span several pages,
+ * see HashTableDirectoryPage for the layout. Segment pages are pinned on first access and unpinned when the
+ * HashTableDirectory is destroyed.
+ *
+ * Segment pages are not latched: the directory is protected by the latch of its root page, which the caller must hold
+ * for reading or writing as long as the HashTableDirectory is used. Modifications of the root page itself must be
+ * made through a guard obtained with AsMut.
+ */
+class HashTableDirectory {
+ public:
+  /**
+   * @param bpm the buffer pool holding the directory
+   * @param swizzler the swizzling interface of bpm, nullptr if it has none
+   * @param segment_refs DIRECTORY_MAX_SEGMENTS swizzled references to the segment pages, indexed by segment
+   * @param root the root directory page, pinned and latched by the caller
+   */
+  HashTableDirectory(BufferPoolManager *bpm, PageSwizzler *swizzler, std::atomic<Page *> *segment_refs,
+                     HashTableDirectoryPage *root)
+      : bpm_(bpm), swizzler_(swizzler), segment_refs_(segment_refs), root_(root) {}
+
+  auto GetGlobalDepth() -> uint32_t { return root_->GetGlobalDepth(); }
+
+  auto GetGlobalDepthMask() -> uint32_t { return root_->GetGlobalDepthMask(); }
+
+  auto Size() -> uint32_t { return root_->Size(); }
+
+  /** @return the number of segments the current directory size spans */
+  auto NumSegments() -> uint32_t { return (Size() + DIRECTORY_ARRAY_SIZE - 1) / DIRECTORY_ARRAY_SIZE; }
+
+  auto GetBucketPageId(uint32_t bucket_idx) -> page_id_t;
+
+  void SetBucketPageId(uint32_t bucket_idx, page_id_t bucket_page_id);
+
+  auto GetLocalDepth(uint32_t bucket_idx) -> uint32_t;
+
+  void SetLocalDepth(uint32_t bucket_idx, uint8_t local_depth);
+
+  void IncrLocalDepth(uint32_t bucket_idx);
+
+  void DecrLocalDepth(uint32_t bucket_idx);
+
+  auto GetLocalDepthMask(uint32_t bucket_idx) -> uint32_t { return (1 << GetLocalDepth(bucket_idx)) - 1; }
+
+  /** @return the directory index of the split image of bucket_idx, see HashTableDirectoryPage::GetSplitImageIndex */
+  auto GetSplitImageIndex(uint32_t bucket_idx) -> uint32_t;
+
+  /**
+   * Increment the global depth, allocating the segment pages the doubled directory needs. The new half of the
+   * directory is left for the caller to fill in.
+   * @return false if the directory is at DIRECTORY_MAX_DEPTH or a segment page could not be allocated
+   */
+  auto IncrGlobalDepth() -> bool;
+
+  /** Decrement the global depth, segment pages no longer used are kept for later growth. */
+  void DecrGlobalDepth() { root_->DecrGlobalDepth(); }
+
+  /** @return true if all local depths are smaller than the global depth */
+  auto CanShrink() -> bool;
+
+  /** Unpin the segment pages now, the HashTableDirectory must not be used afterwards. */
+  void Drop() { segments_.clear(); }
+
+  /**
+   * Verify the invariants of HashTableDirectoryPage::VerifyIntegrity over the whole directory.
+   */
+  void VerifyIntegrity();
+
+ private:
+  /**
+   * @param[in,out] bucket_idx the directory index, replaced by the index within its segment
+   * @param for_write whether the entry will be modified, the segment page is then unpinned dirty
+   * @return the page holding the segment of bucket_idx
+   */
+  auto Segment(uint32_t *bucket_idx, bool for_write) -> HashTableDirectoryPage *;
+
+  BufferPoolManager *bpm_;
+  PageSwizzler *swizzler_;
+  std::atomic<Page *> *segment_refs_;
+  HashTableDirectoryPage *root_;
+  // 已pin的段页，按段的下标存放，只访问根页的一段时不分配
+  std::vector<BasicPageGuard> segments_;
+};
+
+}  // namespace bustub
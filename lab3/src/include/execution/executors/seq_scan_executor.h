@@ -14,9 +14,13 @@
 
 #include <vector>
 
+#include "buffer/optimistic_page_reader.h"
+#include "buffer/page_prefetcher.h"
+#include "buffer/scan_ring.h"
 #include "execution/executor_context.h"
 #include "execution/executors/abstract_executor.h"
 #include "execution/plans/seq_scan_plan.h"
+#include "storage/page/table_page.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
@@ -52,6 +56,12 @@ class SeqScanExecutor : public AbstractExecutor {
                                       const Schema *dest_schema);
 
   auto SchemaEqual(const Schema *table_schema, const Schema *output_schema) -> bool;
+
+  /**
+   * When the iterator enters a new table page, prefetch the next page of the table heap. The id of the next page is
+   * read optimistically from the current page, which the iterator has just read, without pinning or latching it.
+   */
+  void PrefetchNextPage();
   /** The sequential scan plan node to be executed */
   const SeqScanPlanNode *plan_;
 
@@ -59,5 +69,11 @@ class SeqScanExecutor : public AbstractExecutor {
   TableInfo *table_info_; //table_heap_的迭代器
 
   bool is_same_schema_;  // 表模式与输出模式是否一致
+
+  ScanRing scan_ring_;  // 扫描读入的页只在该环内循环使用，不冲掉缓冲池中的热点页
+
+  PagePrefetcher *prefetcher_{nullptr};  // 缓冲池不支持预取时为nullptr
+  OptimisticPageReader *optimistic_reader_{nullptr};  // 缓冲池不支持乐观读时为nullptr
+  page_id_t current_page_id_{INVALID_PAGE_ID};  // 迭代器当前所在的页
 };
 }  // namespace bustub
@@ -0,0 +1,150 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_io.h
+//
+// Identification: src/include/storage/disk/disk_io.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "common/config.h"
+#include "common/macros.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/** Default number of requests a DiskIO backend keeps in flight. */
+static constexpr size_t DISK_IO_QUEUE_DEPTH = 64;
+/** Alignment of buffers, file offsets and sizes required by O_DIRECT I/O. */
+static constexpr size_t DISK_IO_ALIGNMENT = 4096;
+
+/**
+ * AlignedPageBuffer is DISK_IO_ALIGNMENT-aligned memory for a number of pages. Requests on it need no bounce copy
+ * when the DiskIO uses O_DIRECT.
+ */
+class AlignedPageBuffer {
+ public:
+  explicit AlignedPageBuffer(size_t page_count);
+  ~AlignedPageBuffer();
+
+  DISALLOW_COPY_AND_MOVE(AlignedPageBuffer);
+
+  /** @return the i-th page of the buffer */
+  auto At(size_t i) -> char * { return data_ + i * PAGE_SIZE; }
+
+  /** @return number of pages the buffer holds */
+  auto PageCount() const -> size_t { return page_count_; }
+
+ private:
+  size_t page_count_;
+  char *data_;
+};
+
+/**
+ * DiskRequest is a read or write of one page, or of a run of consecutive pages, submitted to a DiskIO.
+ */
+struct DiskRequest {
+  /** true for a write of data_ to the pages, false for a read of the pages into data_ */
+  bool is_write_;
+  /** first page to be read or written */
+  page_id_t page_id_;
+  /** page_count_ * PAGE_SIZE bytes, must stay valid until the request completed */
+  char *data_;
+  /**
+   * Called once the request completed, possibly on another thread, with false if the I/O failed or a write was
+   * short. May be empty.
+   */
+  std::function<void(bool)> callback_;
+  /** number of consecutive pages, from page_id_ on, transferred as one I/O */
+  size_t page_count_{1};
+
+  /** @return number of bytes of the request */
+  auto Size() const -> size_t { return page_count_ * PAGE_SIZE; }
+};
+
+/**
+ * DiskIO is the page I/O interface of the buffer pool. Requests are submitted in batches and complete
+ * asynchronously, so a backend can keep several of them in flight at once.
+ *
+ * Completion callbacks may run on an internal completion thread. They must be short and must not submit new
+ * requests or wait for other requests.
+ */
+class DiskIO {
+ public:
+  DiskIO() = default;
+  virtual ~DiskIO() = default;
+
+  DISALLOW_COPY_AND_MOVE(DiskIO);
+
+  /**
+   * Submit a batch of requests. Blocks while the backend has no room for more requests in flight. Every request
+   * completes exactly once, requests the backend could not issue complete as failed.
+   * @param requests the requests, in the order they should preferably be issued
+   */
+  virtual void Submit(std::vector<DiskRequest> *requests) = 0;
+
+  /**
+   * Submit a batch of requests and wait until all of them completed, callbacks included.
+   * @param requests the requests
+   * @return false if any of the requests failed
+   */
+  auto SubmitAndWait(std::vector<DiskRequest> *requests) -> bool;
+
+  /**
+   * Read a page synchronously on the calling thread. The default goes through SubmitAndWait.
+   * @return false if the read failed
+   */
+  virtual auto ReadPage(page_id_t page_id, char *page_data) -> bool;
+
+  /**
+   * Write a page synchronously on the calling thread. The default goes through SubmitAndWait.
+   * @return false if the page was not written completely
+   */
+  virtual auto WritePage(page_id_t page_id, const char *page_data) -> bool;
+
+  /**
+   * Create the best DiskIO available: an io_uring backend on db_file if the kernel supports it, otherwise a
+   * synchronous backend on top of disk_manager. DiskManager does not expose its file descriptor, so the backends
+   * open db_file themselves; it must be the existing file of disk_manager, it is never created here.
+   *
+   * With direct_io the file is opened with O_DIRECT, so the buffer pool is the only cache of the pages. Requests on
+   * unaligned memory then go through an aligned bounce buffer. Without io_uring, direct I/O is done synchronously with
+   * pread/pwrite; if the file system does not support O_DIRECT, buffered I/O is used.
+   * @param disk_manager the disk manager, used by the synchronous fallback
+   * @param db_file the database file of disk_manager
+   * @param queue_depth maximum number of requests in flight
+   * @param direct_io bypass the kernel page cache
+   */
+  static auto Create(DiskManager *disk_manager, const std::string &db_file, size_t queue_depth = DISK_IO_QUEUE_DEPTH,
+                     bool direct_io = false) -> std::unique_ptr<DiskIO>;
+};
+
+/**
+ * SyncDiskIO performs every request on the submitting thread through DiskManager, one page at a time; runs of pages
+ * are split up.
+ */
+class SyncDiskIO : public DiskIO {
+ public:
+  explicit SyncDiskIO(DiskManager *disk_manager) : disk_manager_(disk_manager) {}
+
+  void Submit(std::vector<DiskRequest> *requests) override;
+
+  auto ReadPage(page_id_t page_id, char *page_data) -> bool override;
+
+  auto WritePage(page_id_t page_id, const char *page_data) -> bool override;
+
+ private:
+  DiskManager *disk_manager_;
+};
+
+}  // namespace bustub
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -30,13 +31,37 @@ namespace bustub {
  *  ----------------------------------------------------------------
  *
  *  Here '+' means concatenation.
- *  The above format omits the space required for the occupied_ and
- *  readable_ arrays. More information is in storage/page/hash_table_page_defs.h.
+ *  The above format omits the space required for the occupied_,
+ *  readable_ and fingerprints_ arrays. More information is in
+ *  storage/page/hash_table_page_defs.h.
+ *
+ *  Each slot also has a one-byte fingerprint of its key, so that a probe
+ *  compares the fingerprints of FINGERPRINT_GROUP_SIZE slots at once and
+ *  calls the comparator only on the slots whose fingerprint matches.
+ *  The fingerprints take the room of some slots, the bucket holds
+ *  SLOT_COUNT pairs instead of BUCKET_ARRAY_SIZE.
+ *
+ *  The page starts with a layout word, BUCKET_LAYOUT_FINGERPRINTS once a
+ *  pair was inserted. Pages of the old layout, without fingerprints,
+ *  start with their occupied_ bitmap instead, whose first word is either 0
+ *  (an empty page, valid in both layouts) or has its low bits set up to
+ *  the first unoccupied slot, which never equals BUCKET_LAYOUT_FINGERPRINTS.
+ *  See HasCurrentLayout.
  *
  */
 template <typename KeyType, typename ValueType, typename KeyComparator>
 class HashTableBucketPage {
  public:
+  /** Number of slots whose fingerprints a probe compares at once. */
+  static constexpr uint32_t FINGERPRINT_GROUP_SIZE = 16;
+
+  /**
+   * Number of slots in a bucket. Each slot takes sizeof(MappingType) bytes, a fingerprint byte and two bitmap bits;
+   * 32 bytes are set aside for the layout word, for rounding the arrays up to whole groups and for the alignment of
+   * array_.
+   */
+  static constexpr uint32_t SLOT_COUNT = 4 * (PAGE_SIZE - 32) / (4 * sizeof(MappingType) + 5);
+
   // Delete all constructor / destructor to ensure memory safety
   HashTableBucketPage() = delete;
 
@@ -47,6 +72,18 @@ class HashTableBucketPage {
    */
   auto GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result) -> bool;
 
+  /**
+   * GetValue, Insert, Remove and Contains taking the hash of the key the caller already computed, so that the key is
+   * not hashed again for its fingerprint. The fingerprint of a slot is the high byte of the hash it was inserted with,
+   * so a bucket must always be accessed either with the caller's hashes or without them, which use KeyHash.
+   *
+   * @param hash hash of key; keys of one bucket may share its low bits, but not necessarily its high byte
+   */
+  auto GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result, uint32_t hash) -> bool;
+  auto Insert(KeyType key, ValueType value, KeyComparator cmp, uint32_t hash) -> bool;
+  auto Remove(KeyType key, ValueType value, KeyComparator cmp, uint32_t hash) -> bool;
+  auto Contains(KeyType key, ValueType value, KeyComparator cmp, uint32_t hash) const -> bool;
+
   /**
    * Attempts to insert a key and value in the bucket.  Uses the occupied_
    * and readable_ arrays to keep track of each slot's availability.
@@ -58,12 +95,26 @@ class HashTableBucketPage {
   auto Insert(KeyType key, ValueType value, KeyComparator cmp) -> bool;
 
   /**
-   * Removes a key and value.
+   * Removes a key and value. The bucket is compacted when it holds more tombstones than pairs.
    *
    * @return true if removed, false if not found
    */
   auto Remove(KeyType key, ValueType value, KeyComparator cmp) -> bool;
 
+  /**
+   * Checks for a key and value without modifying the bucket, so that callers can tell whether Insert or Remove would
+   * change the page before writing to it.
+   *
+   * @return true if the bucket holds the pair
+   */
+  auto Contains(KeyType key, ValueType value, KeyComparator cmp) const -> bool;
+
+  /**
+   * Moves the readable pairs to the first slots and clears the tombstones, so that probes, which stop at the first
+   * unoccupied slot, scan only as many slots as there are pairs. Slot indexes of the pairs may change.
+   */
+  void Compact();
+
   /**
    * Gets the key at an index in the bucket.
    *
@@ -135,17 +186,81 @@ class HashTableBucketPage {
    */
   auto IsEmpty() -> bool;
 
+  /**
+   * A page of the old layout is treated as a bucket that can be neither read nor changed: lookups find nothing,
+   * Insert and Remove fail, and it is reported full and not empty, so that it is never split or merged.
+   *
+   * @return false if the page was written with the old layout, without fingerprints
+   */
+  auto HasCurrentLayout() const -> bool;
+
+  /** @return the hash of key used by the methods not taking a hash, mixed so that its high byte varies */
+  static auto KeyHash(const KeyType &key) -> uint32_t;
+
   /**
    * Prints the bucket's occupancy information
    */
   void PrintBucket();
 
  private:
+  /** Layout word of a bucket page with fingerprints, "BFP1". */
+  static constexpr uint32_t BUCKET_LAYOUT_FINGERPRINTS = 0x31504642;
+  /** Number of bytes of each bitmap, rounded up to whole groups. */
+  static constexpr uint32_t BITMAP_SIZE = (SLOT_COUNT - 1) / FINGERPRINT_GROUP_SIZE * FINGERPRINT_GROUP_SIZE / 8 + 2;
+  /** Bits of a group whose slots are all set. */
+  static constexpr uint32_t FULL_GROUP = (1U << FINGERPRINT_GROUP_SIZE) - 1;
+  /** Remove compacts the bucket once it has at least this many tombstones and more tombstones than pairs. */
+  static constexpr uint32_t COMPACT_MIN_TOMBSTONES = FINGERPRINT_GROUP_SIZE;
+  /** Number of 64-bit words covering the slots of a bitmap, the last one may extend past BITMAP_SIZE. */
+  static constexpr uint32_t BITMAP_WORDS = (SLOT_COUNT - 1) / 64 + 1;
+
+  /** @return the fingerprint of a key with the given hash */
+  static auto Fingerprint(uint32_t hash) -> uint8_t { return static_cast<uint8_t>(hash >> 24); }
+
+  /** @return the bits of the group at group_start that stand for slots, all of them except in the last group */
+  static auto GroupMask(uint32_t group_start) -> uint32_t;
+
+  /**
+   * @param bitmap occupied_ or readable_
+   * @param group_start first slot of a group, a multiple of FINGERPRINT_GROUP_SIZE
+   * @return the bits of the group's slots, bit i for slot group_start + i
+   */
+  static auto LoadGroupBits(const unsigned char *bitmap, uint32_t group_start) -> uint32_t;
+
+  /**
+   * @param bitmap occupied_ or readable_
+   * @return word word_idx of the bitmap, bit i for slot word_idx * 64 + i; bits past the bitmap are 0
+   */
+  static auto LoadWord(const unsigned char *bitmap, uint32_t word_idx) -> uint64_t;
+
+  /** @return the bits of word word_idx that stand for slots, all of them except in the last word */
+  static auto WordMask(uint32_t word_idx) -> uint64_t;
+
+  /** @return the number of occupied slots, pairs and tombstones */
+  auto NumOccupied() const -> uint32_t;
+
+  /** @return the first slot that is not readable, SLOT_COUNT if the bucket is full */
+  auto FindFreeSlot() const -> uint32_t;
+
+  /**
+   * @param group_start first slot of a group, a multiple of FINGERPRINT_GROUP_SIZE
+   * @return the readable slots of the group whose fingerprint equals fingerprint, bit i for slot group_start + i;
+   * never a slot past SLOT_COUNT, whatever the padding bytes of the page hold
+   */
+  auto MatchGroup(uint32_t group_start, uint8_t fingerprint) const -> uint32_t;
+
+  /** @return the readable slot holding key and value, SLOT_COUNT if there is none; fingerprint is that of key */
+  auto FindPair(const KeyType &key, const ValueType &value, uint8_t fingerprint, KeyComparator cmp) const
+      -> uint32_t;
+
+  // 旧布局的页从occupied_开始，由这个字区分两种布局
+  uint32_t layout_;
   // 将数组类型改成unsigned char，便于比较
-  //  For more on BUCKET_ARRAY_SIZE see storage/page/hash_table_page_defs.h
-  unsigned char occupied_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
+  unsigned char occupied_[BITMAP_SIZE];
   // 0 if tombstone/brand new (never occupied), 1 otherwise.
-  unsigned char readable_[(BUCKET_ARRAY_SIZE - 1) / 8 + 1];
+  unsigned char readable_[BITMAP_SIZE];
+  // 每个槽的键的指纹，补齐到整组，探测时一次比较一组
+  uint8_t fingerprints_[BITMAP_SIZE * 8];
   MappingType array_[1];
 };
 
@@ -22,14 +22,29 @@
 
 namespace bustub {
 
+/** Maximum number of pages of a directory, the root directory page included. */
+static constexpr uint32_t DIRECTORY_MAX_SEGMENTS = 256;
+/** Maximum number of entries of a directory spanning DIRECTORY_MAX_SEGMENTS pages. */
+static constexpr uint32_t DIRECTORY_MAX_SIZE = DIRECTORY_ARRAY_SIZE * DIRECTORY_MAX_SEGMENTS;
+/** Maximum global depth of a directory. */
+static constexpr uint32_t DIRECTORY_MAX_DEPTH = 17;
+static_assert(1U << DIRECTORY_MAX_DEPTH == DIRECTORY_MAX_SIZE, "DIRECTORY_MAX_DEPTH does not match DIRECTORY_MAX_SIZE");
+
 /**
  *
  * Directory Page for extendible hash table.
  *
  * Directory format (size in byte):
  * --------------------------------------------------------------------------------------------
- * | LSN (4) | PageId(4) | GlobalDepth(4) | LocalDepths(512) | BucketPageIds(2048) | Free(1524)
+ * | LSN (4) | PageId(4) | GlobalDepth(4) | LocalDepths(512) | BucketPageIds(2048) | NumSegmentPages(4)
+ * --------------------------------------------------------------------------------------------
+ * | SegmentPageIds(1020) | Free(500)
  * --------------------------------------------------------------------------------------------
+ *
+ * A directory larger than DIRECTORY_ARRAY_SIZE entries is split into segments of DIRECTORY_ARRAY_SIZE entries.
+ * Segment 0 is the entry arrays of the root directory page itself, segment s > 0 is the entry arrays of another
+ * HashTableDirectoryPage, whose page id the root keeps in SegmentPageIds. Only the root's global depth is used.
+ * Entry accessors of a page only cover its own segment, see HashTableDirectory for the whole directory.
  */
 class HashTableDirectoryPage {
  public:
@@ -124,7 +139,7 @@ class HashTableDirectoryPage {
   void DecrGlobalDepth();
 
   /**
-   * @return true if the directory can be shrunk
+   * @return true if the directory can be shrunk, only valid while the directory fits in this page
    */
   auto CanShrink() -> bool;
 
@@ -171,6 +186,26 @@ class HashTableDirectoryPage {
    */
   auto GetLocalHighBit(uint32_t bucket_idx) -> uint32_t;
 
+  /**
+   * @return the number of segment pages allocated besides the root, they are kept when the directory shrinks
+   */
+  auto GetNumSegmentPages() -> uint32_t;
+
+  /** @param num_segment_pages the number of allocated segment pages */
+  void SetNumSegmentPages(uint32_t num_segment_pages);
+
+  /**
+   * @param segment_idx index of the segment, 0 < segment_idx <= GetNumSegmentPages()
+   * @return the page_id of the segment page
+   */
+  auto GetSegmentPageId(uint32_t segment_idx) -> page_id_t;
+
+  /**
+   * @param segment_idx index of the segment, 0 < segment_idx < DIRECTORY_MAX_SEGMENTS
+   * @param segment_page_id the page_id of the segment page
+   */
+  void SetSegmentPageId(uint32_t segment_idx, page_id_t segment_page_id);
+
   /**
    * VerifyIntegrity
    *
@@ -178,6 +213,8 @@ class HashTableDirectoryPage {
    * (1) All LD <= GD.
    * (2) Each bucket has precisely 2^(GD - LD) pointers pointing to it.
    * (3) The LD is the same at each index with the same bucket_page_id
+   *
+   * Only valid while the directory fits in this page.
    */
   void VerifyIntegrity();
 
@@ -192,6 +229,8 @@ class HashTableDirectoryPage {
   uint32_t global_depth_{0};
   uint8_t local_depths_[DIRECTORY_ARRAY_SIZE];
   page_id_t bucket_page_ids_[DIRECTORY_ARRAY_SIZE];
+  uint32_t num_segment_pages_{0};
+  page_id_t segment_page_ids_[DIRECTORY_MAX_SEGMENTS - 1];  // 第s段的页号存放在下标s-1处
 };
 
 }  // namespace bustub
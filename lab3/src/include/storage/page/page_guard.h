@@ -0,0 +1,219 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_guard.h
+//
+// Identification: src/include/storage/page/page_guard.h
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/optimistic_page_reader.h"
+#include "buffer/page_swizzler.h"
+#include "common/config.h"
+#include "storage/page/page.h"
+
+namespace bustub {
+
+class ReadPageGuard;
+class WritePageGuard;
+
+/**
+ * BasicPageGuard owns one pin of a page and unpins it when it is dropped or destroyed. Guards can be moved but not
+ * copied, moving one transfers the pin.
+ *
+ * The page is unpinned dirty only if it was accessed through AsMut or GetDataMut. As and GetData are for read-only
+ * access; they return non-const pointers because the page classes of this tree are not const-correct.
+ */
+class BasicPageGuard {
+ public:
+  BasicPageGuard() = default;
+
+  /**
+   * @param bpm the buffer pool the page was pinned in
+   * @param page the pinned page, nullptr for an empty guard
+   * @param swizzler if not nullptr, the page was pinned with PinSwizzled and is unpinned through it
+   */
+  BasicPageGuard(BufferPoolManager *bpm, Page *page, PageSwizzler *swizzler = nullptr)
+      : bpm_(bpm), page_(page), swizzler_(swizzler) {}
+
+  BasicPageGuard(const BasicPageGuard &) = delete;
+  auto operator=(const BasicPageGuard &) -> BasicPageGuard & = delete;
+
+  BasicPageGuard(BasicPageGuard &&that) noexcept;
+  auto operator=(BasicPageGuard &&that) noexcept -> BasicPageGuard &;
+
+  ~BasicPageGuard() { Drop(); }
+
+  /** Unpin the page now, the guard is empty afterwards. */
+  void Drop();
+
+  /**
+   * Latch the page for reading and move the pin into a ReadPageGuard, this guard is empty afterwards.
+   * @return the read guard, empty if this guard is empty
+   */
+  auto UpgradeRead() -> ReadPageGuard;
+
+  /**
+   * Latch the page for writing and move the pin into a WritePageGuard, this guard is empty afterwards.
+   * @return the write guard, empty if this guard is empty
+   */
+  auto UpgradeWrite() -> WritePageGuard;
+
+  /** @return false if the guard is empty, e.g. because the fetch failed */
+  auto IsValid() const -> bool { return page_ != nullptr; }
+
+  auto PageId() -> page_id_t { return page_->GetPageId(); }
+
+  auto GetData() -> char * { return page_->GetData(); }
+
+  /** @return the page data for modification, the page will be unpinned dirty */
+  auto GetDataMut() -> char * {
+    is_dirty_ = true;
+    return page_->GetData();
+  }
+
+  template <class T>
+  auto As() -> T * {
+    return reinterpret_cast<T *>(GetData());
+  }
+
+  template <class T>
+  auto AsMut() -> T * {
+    return reinterpret_cast<T *>(GetDataMut());
+  }
+
+ private:
+  friend class ReadPageGuard;
+  friend class WritePageGuard;
+
+  BufferPoolManager *bpm_{nullptr};
+  Page *page_{nullptr};
+  PageSwizzler *swizzler_{nullptr};
+  bool is_dirty_{false};
+};
+
+/**
+ * ReadPageGuard owns one pin and the read latch of a page, and releases both when it is dropped or destroyed.
+ */
+class ReadPageGuard {
+ public:
+  ReadPageGuard() = default;
+
+  /** @param guard pin of the page, the read latch must already be held */
+  explicit ReadPageGuard(BasicPageGuard &&guard) : guard_(std::move(guard)) {}
+
+  ReadPageGuard(ReadPageGuard &&that) noexcept = default;
+  auto operator=(ReadPageGuard &&that) noexcept -> ReadPageGuard &;
+
+  ~ReadPageGuard() { Drop(); }
+
+  /** Release the read latch and unpin the page now, the guard is empty afterwards. */
+  void Drop();
+
+  auto IsValid() const -> bool { return guard_.IsValid(); }
+
+  auto PageId() -> page_id_t { return guard_.PageId(); }
+
+  auto GetData() -> char * { return guard_.GetData(); }
+
+  template <class T>
+  auto As() -> T * {
+    return guard_.As<T>();
+  }
+
+ private:
+  BasicPageGuard guard_;
+};
+
+/**
+ * WritePageGuard owns one pin and the write latch of a page, and releases both when it is dropped or destroyed.
+ * If the buffer pool supports optimistic reads, the first GetDataMut or AsMut starts a BeginPageWrite section that
+ * ends before the latch is released.
+ */
+class WritePageGuard {
+ public:
+  WritePageGuard() = default;
+
+  /** @param guard pin of the page, the write latch must already be held */
+  explicit WritePageGuard(BasicPageGuard &&guard) : guard_(std::move(guard)) {}
+
+  WritePageGuard(WritePageGuard &&that) noexcept;
+  auto operator=(WritePageGuard &&that) noexcept -> WritePageGuard &;
+
+  ~WritePageGuard() { Drop(); }
+
+  /** Release the write latch and unpin the page now, the guard is empty afterwards. */
+  void Drop();
+
+  auto IsValid() const -> bool { return guard_.IsValid(); }
+
+  auto PageId() -> page_id_t { return guard_.PageId(); }
+
+  auto GetData() -> char * { return guard_.GetData(); }
+
+  /** @return the page data for modification, the page will be unpinned dirty */
+  auto GetDataMut() -> char *;
+
+  template <class T>
+  auto As() -> T * {
+    return guard_.As<T>();
+  }
+
+  template <class T>
+  auto AsMut() -> T * {
+    return reinterpret_cast<T *>(GetDataMut());
+  }
+
+ private:
+  BasicPageGuard guard_;
+  /** Whether the page was accessed through GetDataMut or AsMut. */
+  bool modified_{false};
+  /** Set while a BeginPageWrite section is open. */
+  OptimisticPageReader *writing_{nullptr};
+};
+
+/**
+ * Fetch a page and pin it.
+ * @return the guard, empty if the page could not be fetched
+ */
+auto FetchPageBasic(BufferPoolManager *bpm, page_id_t page_id) -> BasicPageGuard;
+
+/**
+ * Fetch a page, pin it and latch it for reading.
+ * @return the guard, empty if the page could not be fetched
+ */
+auto FetchPageRead(BufferPoolManager *bpm, page_id_t page_id) -> ReadPageGuard;
+
+/**
+ * Fetch a page, pin it and latch it for writing.
+ * @return the guard, empty if the page could not be fetched
+ */
+auto FetchPageWrite(BufferPoolManager *bpm, page_id_t page_id) -> WritePageGuard;
+
+/**
+ * Create a new page and pin it.
+ * @param[out] page_id id of the new page
+ * @return the guard, empty if no page could be created
+ */
+auto NewPageGuarded(BufferPoolManager *bpm, page_id_t *page_id) -> BasicPageGuard;
+
+/**
+ * Pin a page through a swizzled reference if it is still valid. Otherwise the page is fetched and swizzled into the
+ * reference.
+ * @param swizzler the swizzling interface of bpm, nullptr if it has none
+ * @param ref the swizzled reference, may be stale or nullptr
+ * @return the guard, empty if the page could not be fetched
+ */
+auto PinPageThroughRef(BufferPoolManager *bpm, PageSwizzler *swizzler, std::atomic<Page *> *ref, page_id_t page_id)
+    -> BasicPageGuard;
+
+}  // namespace bustub
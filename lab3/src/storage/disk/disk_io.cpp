@@ -0,0 +1,563 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_io.cpp
+//
+// Identification: src/storage/disk/disk_io.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/disk_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+
+#include "common/logger.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+// io_uring后端直接使用系统调用，不依赖liburing；内核或头文件不支持时只有同步后端
+#if __has_include(<linux/io_uring.h>)
+#define BUSTUB_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace bustub {
+
+AlignedPageBuffer::AlignedPageBuffer(size_t page_count)
+    : page_count_(std::max<size_t>(page_count, 1)),
+      data_(static_cast<char *>(std::aligned_alloc(DISK_IO_ALIGNMENT, page_count_ * PAGE_SIZE))) {
+  BUSTUB_ASSERT(data_ != nullptr, "failed to allocate an aligned page buffer");
+}
+
+AlignedPageBuffer::~AlignedPageBuffer() { std::free(data_); }  // NOLINT
+
+auto DiskIO::SubmitAndWait(std::vector<DiskRequest> *requests) -> bool {
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t remaining = requests->size();
+  bool all_ok = true;
+  for (auto &request : *requests) {
+    request.callback_ = [&mutex, &done, &remaining, &all_ok, callback = std::move(request.callback_)](bool ok) {
+      if (callback) {
+        callback(ok);
+      }
+      std::lock_guard<std::mutex> lock(mutex);
+      all_ok = all_ok && ok;
+      if (--remaining == 0) {
+        done.notify_all();
+      }
+    };
+  }
+  Submit(requests);
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return remaining == 0; });
+  return all_ok;
+}
+
+auto DiskIO::ReadPage(page_id_t page_id, char *page_data) -> bool {
+  std::vector<DiskRequest> requests{{false, page_id, page_data, nullptr}};
+  return SubmitAndWait(&requests);
+}
+
+auto DiskIO::WritePage(page_id_t page_id, const char *page_data) -> bool {
+  std::vector<DiskRequest> requests{{true, page_id, const_cast<char *>(page_data), nullptr}};  // 写请求不会修改数据
+  return SubmitAndWait(&requests);
+}
+
+void SyncDiskIO::Submit(std::vector<DiskRequest> *requests) {
+  for (auto &request : *requests) {
+    for (size_t i = 0; i < request.page_count_; i++) {
+      auto page_id = static_cast<page_id_t>(request.page_id_ + i);
+      if (request.is_write_) {
+        disk_manager_->WritePage(page_id, request.data_ + i * PAGE_SIZE);
+      } else {
+        disk_manager_->ReadPage(page_id, request.data_ + i * PAGE_SIZE);
+      }
+    }
+    if (request.callback_) {
+      request.callback_(true);  // DiskManager自己处理并记录I/O错误，不向调用者报告
+    }
+  }
+}
+
+auto SyncDiskIO::ReadPage(page_id_t page_id, char *page_data) -> bool {
+  disk_manager_->ReadPage(page_id, page_data);
+  return true;
+}
+
+auto SyncDiskIO::WritePage(page_id_t page_id, const char *page_data) -> bool {
+  disk_manager_->WritePage(page_id, page_data);
+  return true;
+}
+
+#ifdef __linux__
+namespace {
+
+/**
+ * Open the database file of the DiskManager for DiskIO backends. The file is not created: a missing file means
+ * db_file is not the DiskManager's file, and the backends must not write pages anywhere else.
+ * @param[in,out] direct_io whether to use O_DIRECT, cleared if the file system does not support it
+ * @return the file descriptor, -1 on failure
+ */
+auto OpenDbFile(const std::string &db_file, bool *direct_io) -> int {
+  if (*direct_io) {
+    int fd = open(db_file.c_str(), O_RDWR | O_DIRECT);  // NOLINT
+    if (fd >= 0) {
+      return fd;
+    }
+    if (errno == ENOENT) {
+      LOG_DEBUG("%s does not exist, it must be the file of the DiskManager", db_file.c_str());
+      return -1;
+    }
+    LOG_DEBUG("O_DIRECT is not supported for %s, falling back to buffered I/O", db_file.c_str());
+    *direct_io = false;
+  }
+  int fd = open(db_file.c_str(), O_RDWR);  // NOLINT
+  if (fd < 0) {
+    LOG_DEBUG("cannot open %s, falling back to the DiskManager", db_file.c_str());
+  }
+  return fd;
+}
+
+/**
+ * BouncePool recycles the aligned bounce buffers of O_DIRECT requests on unaligned memory, so that a request does not
+ * allocate one. It keeps at most max_free buffers.
+ */
+class BouncePool {
+ public:
+  explicit BouncePool(size_t max_free) : max_free_(max_free) {}
+
+  /** @return a buffer of at least page_count pages */
+  auto Acquire(size_t page_count) -> std::unique_ptr<AlignedPageBuffer> {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto iter = free_.begin(); iter != free_.end(); ++iter) {
+        if ((*iter)->PageCount() >= page_count) {
+          std::unique_ptr<AlignedPageBuffer> buffer = std::move(*iter);
+          *iter = std::move(free_.back());
+          free_.pop_back();
+          return buffer;
+        }
+      }
+    }
+    return std::make_unique<AlignedPageBuffer>(page_count);
+  }
+
+  void Release(std::unique_ptr<AlignedPageBuffer> buffer) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.size() < max_free_) {
+      free_.push_back(std::move(buffer));
+    }
+  }
+
+ private:
+  size_t max_free_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<AlignedPageBuffer>> free_;
+};
+
+/**
+ * IOBuffer is the memory the kernel reads into or writes from for a request: the request memory itself, or an
+ * aligned bounce buffer from pool if O_DIRECT is used and the request memory is not aligned (Page frames after the
+ * first one are not, unless the pool was created with FrameArenaOptions::aligned_frames_).
+ */
+class IOBuffer {
+ public:
+  IOBuffer(const DiskRequest &request, bool direct_io, BouncePool *pool) : pool_(pool) {
+    if (direct_io && reinterpret_cast<uintptr_t>(request.data_) % DISK_IO_ALIGNMENT != 0) {
+      bounce_ = pool_->Acquire(request.page_count_);
+      if (request.is_write_) {
+        memcpy(bounce_->At(0), request.data_, request.Size());
+      }
+    }
+  }
+
+  ~IOBuffer() {
+    if (bounce_ != nullptr) {
+      pool_->Release(std::move(bounce_));
+    }
+  }
+
+  DISALLOW_COPY_AND_MOVE(IOBuffer);
+
+  auto Data(const DiskRequest &request) -> char * { return bounce_ != nullptr ? bounce_->At(0) : request.data_; }
+
+  /**
+   * Finish a request after the kernel returned res for it.
+   * @param res number of bytes transferred, or a negative error
+   * @return whether the request succeeded: a write must have transferred all bytes, a read must not have failed
+   */
+  auto Finish(const DiskRequest &request, ssize_t res) -> bool {
+    bool ok = res >= 0 && (!request.is_write_ || res == static_cast<ssize_t>(request.Size()));
+    if (!ok) {
+      LOG_DEBUG("%s of page %d failed, result %zd", request.is_write_ ? "write" : "read", request.page_id_, res);
+    }
+    // 与DiskManager一致，短读时剩余部分补0，读文件末尾之后的页得到全0的页
+    if (!request.is_write_ && res < static_cast<ssize_t>(request.Size())) {
+      size_t read_count = res < 0 ? 0 : static_cast<size_t>(res);
+      memset(Data(request) + read_count, 0, request.Size() - read_count);
+    }
+    if (bounce_ != nullptr && !request.is_write_) {
+      memcpy(request.data_, bounce_->At(0), request.Size());
+    }
+    return ok;
+  }
+
+ private:
+  BouncePool *pool_;
+  std::unique_ptr<AlignedPageBuffer> bounce_;
+};
+
+/**
+ * FileDiskIO is the base of the backends doing I/O on their own descriptor of the database file. Single pages are
+ * read and written with pread/pwrite on the calling thread, without a round trip through Submit.
+ */
+class FileDiskIO : public DiskIO {
+ public:
+  /**
+   * @param file_fd descriptor of the database file, owned by this FileDiskIO unless it is reset to -1
+   * @param max_bounce number of bounce buffers kept for reuse
+   */
+  FileDiskIO(int file_fd, bool direct_io, size_t max_bounce)
+      : file_fd_(file_fd), direct_io_(direct_io), bounce_pool_(max_bounce) {}
+  ~FileDiskIO() override {
+    if (file_fd_ >= 0) {
+      close(file_fd_);
+    }
+  }
+
+  auto ReadPage(page_id_t page_id, char *page_data) -> bool override {
+    return Transfer({false, page_id, page_data, nullptr});
+  }
+
+  auto WritePage(page_id_t page_id, const char *page_data) -> bool override {
+    return Transfer({true, page_id, const_cast<char *>(page_data), nullptr});  // 写请求不会修改数据
+  }
+
+ protected:
+  /**
+   * Perform a request on the calling thread with pread/pwrite. The callback of the request is not run.
+   * @return whether the request succeeded
+   */
+  auto Transfer(const DiskRequest &request) -> bool {
+    IOBuffer buffer(request, direct_io_, &bounce_pool_);
+    off_t offset = static_cast<off_t>(request.page_id_) * PAGE_SIZE;
+    ssize_t res;
+    do {
+      res = request.is_write_ ? pwrite(file_fd_, buffer.Data(request), request.Size(), offset)
+                              : pread(file_fd_, buffer.Data(request), request.Size(), offset);
+    } while (res < 0 && errno == EINTR);
+    return buffer.Finish(request, res);
+  }
+
+  int file_fd_;
+  bool direct_io_;
+  BouncePool bounce_pool_;
+};
+
+/**
+ * PosixDiskIO performs every request on the submitting thread with pread/pwrite. It is the fallback for direct I/O
+ * without io_uring.
+ */
+class PosixDiskIO : public FileDiskIO {
+ public:
+  PosixDiskIO(int file_fd, bool direct_io, size_t queue_depth) : FileDiskIO(file_fd, direct_io, queue_depth) {}
+
+  void Submit(std::vector<DiskRequest> *requests) override {
+    for (auto &request : *requests) {
+      bool ok = Transfer(request);
+      if (request.callback_) {
+        request.callback_(ok);
+      }
+    }
+  }
+};
+
+}  // namespace
+#endif
+
+#ifdef BUSTUB_HAS_IO_URING
+namespace {
+
+/**
+ * IoUringDiskIO keeps up to queue_depth page reads and writes in flight on an io_uring instance. Requests are issued
+ * directly on the database file; a completion thread reaps them and runs their callbacks. Single page reads and
+ * writes bypass the ring.
+ */
+class IoUringDiskIO : public FileDiskIO {
+ public:
+  /**
+   * @param file_fd descriptor of the database file, owned by the returned IoUringDiskIO
+   * @return nullptr if the kernel does not support io_uring, file_fd is not closed then
+   */
+  static auto Open(int file_fd, bool direct_io, size_t queue_depth) -> std::unique_ptr<IoUringDiskIO> {
+    auto disk_io = std::unique_ptr<IoUringDiskIO>(new IoUringDiskIO(file_fd, direct_io, queue_depth));
+    if (!disk_io->Setup(queue_depth)) {
+      disk_io->file_fd_ = -1;
+      return nullptr;
+    }
+    disk_io->reaper_ = std::thread([io = disk_io.get()] { io->Reap(); });
+    return disk_io;
+  }
+
+  ~IoUringDiskIO() override {
+    if (reaper_.joinable()) {
+      // 等待所有请求完成，再提交一个user_data为0的NOP通知完成线程退出
+      std::unique_lock<std::mutex> lock(mutex_);
+      space_.wait(lock, [this] { return in_flight_ == 0; });
+      io_uring_sqe *sqe = NextSqe();
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = 0;
+      Enter(1);
+      lock.unlock();
+      reaper_.join();
+    }
+    if (sqes_ != nullptr) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+      munmap(cq_ptr_, cq_size_);
+    }
+    if (sq_ptr_ != nullptr) {
+      munmap(sq_ptr_, sq_size_);
+    }
+    if (ring_fd_ >= 0) {
+      close(ring_fd_);
+    }
+  }
+
+  void Submit(std::vector<DiskRequest> *requests) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    size_t next = 0;
+    while (next < requests->size()) {
+      space_.wait(lock, [this] { return in_flight_ < entries_; });
+      unsigned to_submit = 0;
+      for (; next < requests->size() && in_flight_ < entries_; next++) {
+        auto *op = new InFlight(std::move((*requests)[next]), direct_io_, &bounce_pool_);
+        op->iov_.iov_base = op->buffer_.Data(op->request_);
+        op->iov_.iov_len = op->request_.Size();
+        io_uring_sqe *sqe = NextSqe();
+        sqe->opcode = op->request_.is_write_ ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = file_fd_;
+        sqe->off = static_cast<uint64_t>(op->request_.page_id_) * PAGE_SIZE;
+        sqe->addr = reinterpret_cast<uint64_t>(&op->iov_);
+        sqe->len = 1;
+        sqe->user_data = reinterpret_cast<uint64_t>(op);
+        to_submit++;
+        in_flight_++;
+      }
+      unsigned rejected = Enter(to_submit);
+      if (rejected > 0) {
+        // 内核没有取走的提交队列项收回，这些请求不会再有完成事件，以失败完成它们，否则等待它们的线程会一直阻塞
+        std::vector<InFlight *> ops;
+        for (unsigned i = 0; i < rejected; i++) {
+          sq_local_tail_--;
+          ops.push_back(reinterpret_cast<InFlight *>(sqes_[sq_local_tail_ & sq_mask_].user_data));
+        }
+        __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+        in_flight_ -= rejected;
+        lock.unlock();
+        for (InFlight *op : ops) {
+          Complete(op, -EIO);
+        }
+        lock.lock();
+        space_.notify_all();
+      }
+    }
+  }
+
+ private:
+  /** A submitted request, owned by the ring until its completion is reaped. */
+  struct InFlight {
+    InFlight(DiskRequest request, bool direct_io, BouncePool *pool)
+        : request_(std::move(request)), buffer_(request_, direct_io, pool) {}
+
+    DiskRequest request_;
+    IOBuffer buffer_;
+    struct iovec iov_ {};
+  };
+
+  IoUringDiskIO(int file_fd, bool direct_io, size_t queue_depth) : FileDiskIO(file_fd, direct_io, queue_depth) {}
+
+  auto Setup(size_t queue_depth) -> bool {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, static_cast<unsigned>(queue_depth), &params));
+    if (ring_fd_ < 0) {
+      LOG_DEBUG("io_uring is not available, falling back to synchronous disk I/O");
+      return false;
+    }
+    entries_ = params.sq_entries;
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+    sq_ptr_ = Map(sq_size_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == nullptr) {
+      return false;
+    }
+    cq_ptr_ = single_mmap ? sq_ptr_ : Map(cq_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe *>(Map(sqes_size_, IORING_OFF_SQES));
+    if (cq_ptr_ == nullptr || sqes_ == nullptr) {
+      return false;
+    }
+    auto *sq = static_cast<char *>(sq_ptr_);
+    sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    auto *cq = static_cast<char *>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+    sq_local_tail_ = *sq_tail_;
+    return true;
+  }
+
+  auto Map(size_t size, off_t offset) -> void * {
+    void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    return ptr == MAP_FAILED ? nullptr : ptr;
+  }
+
+  /** Claim the next submission queue entry, mutex_ must be held. */
+  auto NextSqe() -> io_uring_sqe * {
+    unsigned index = sq_local_tail_ & sq_mask_;
+    io_uring_sqe *sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    sq_local_tail_++;
+    return sqe;
+  }
+
+  /**
+   * Publish the claimed entries and hand them to the kernel, mutex_ must be held.
+   * @return number of entries, at the end of the claimed ones, the kernel did not take because io_uring_enter failed
+   */
+  auto Enter(unsigned to_submit) -> unsigned {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    while (to_submit > 0) {
+      long ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, 0, nullptr, 0);  // NOLINT
+      if (ret < 0) {
+        if (errno == EINTR || errno == EAGAIN) {
+          continue;
+        }
+        LOG_DEBUG("io_uring_enter failed, errno %d", errno);
+        return to_submit;
+      }
+      to_submit -= static_cast<unsigned>(ret);
+    }
+    return 0;
+  }
+
+  /** Completion thread: wait for completions and run their callbacks, until the NOP of the destructor arrives. */
+  void Reap() {
+    bool stopping = false;
+    std::vector<std::pair<InFlight *, int>> completions;
+    while (!stopping) {
+      syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      {
+        // 请求是在持有mutex_时提交的，加锁后再读取，保证能看到提交线程写入的请求内容
+        std::lock_guard<std::mutex> lock(mutex_);
+        unsigned head = *cq_head_;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+          const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+          if (cqe.user_data == 0) {
+            stopping = true;
+          } else {
+            completions.emplace_back(reinterpret_cast<InFlight *>(cqe.user_data), cqe.res);
+          }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+      }
+      if (completions.empty()) {
+        continue;
+      }
+      // 回调不持有mutex_，回调中可能需要加缓冲池的锁
+      for (const auto &[op, res] : completions) {
+        Complete(op, res);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_flight_ -= completions.size();
+      completions.clear();
+      space_.notify_all();
+    }
+  }
+
+  void Complete(InFlight *op, int res) {
+    bool ok = op->buffer_.Finish(op->request_, res);
+    if (op->request_.callback_) {
+      op->request_.callback_(ok);
+    }
+    delete op;
+  }
+
+  int ring_fd_{-1};
+  /** Number of submission queue entries, at most this many requests are in flight. */
+  unsigned entries_{0};
+  void *sq_ptr_{nullptr};
+  void *cq_ptr_{nullptr};
+  size_t sq_size_{0};
+  size_t cq_size_{0};
+  size_t sqes_size_{0};
+  io_uring_sqe *sqes_{nullptr};
+  unsigned *sq_tail_{nullptr};
+  unsigned *sq_array_{nullptr};
+  unsigned sq_mask_{0};
+  unsigned sq_local_tail_{0};
+  unsigned *cq_head_{nullptr};
+  unsigned *cq_tail_{nullptr};
+  unsigned cq_mask_{0};
+  io_uring_cqe *cqes_{nullptr};
+
+  /** Protects the submission queue and in_flight_. */
+  std::mutex mutex_;
+  /** Signalled when requests complete. */
+  std::condition_variable space_;
+  size_t in_flight_{0};
+  std::thread reaper_;
+};
+
+}  // namespace
+#endif
+
+auto DiskIO::Create(DiskManager *disk_manager, const std::string &db_file, size_t queue_depth, bool direct_io)
+    -> std::unique_ptr<DiskIO> {
+#ifdef __linux__
+  int file_fd = OpenDbFile(db_file, &direct_io);
+  if (file_fd >= 0) {
+#ifdef BUSTUB_HAS_IO_URING
+    std::unique_ptr<DiskIO> disk_io = IoUringDiskIO::Open(file_fd, direct_io, queue_depth);
+    if (disk_io != nullptr) {
+      return disk_io;
+    }
+#endif
+    if (direct_io) {
+      return std::make_unique<PosixDiskIO>(file_fd, true, queue_depth);  // DiskManager的读写总是经过页缓存
+    }
+    close(file_fd);
+  }
+#endif
+  return std::make_unique<SyncDiskIO>(disk_manager);
+}
+
+}  // namespace bustub
@@ -11,6 +11,14 @@
 //===----------------------------------------------------------------------===//
 
 #include "storage/page/hash_table_bucket_page.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+
 #include "common/logger.h"
 #include "common/util/hash_util.h"
 #include "storage/index/generic_key.h"
@@ -21,13 +29,43 @@ namespace bustub {
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result) -> bool {
+  return GetValue(key, cmp, result, KeyHash(key));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator cmp) -> bool {
+  return Insert(key, value, cmp, KeyHash(key));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, KeyComparator cmp) -> bool {
+  return Remove(key, value, cmp, KeyHash(key));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::Contains(KeyType key, ValueType value, KeyComparator cmp) const -> bool {
+  return Contains(key, value, cmp, KeyHash(key));
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vector<ValueType> *result, uint32_t hash)
+    -> bool {
+  if (!HasCurrentLayout()) {
+    return false;
+  }
   bool flag = false;  // 标志是否找到相应value值
-  uint32_t array_size = BUCKET_ARRAY_SIZE;
-  for (uint32_t i = 0; i < array_size; i++) {
-    if (IsReadable(i) && cmp(array_[i].first, key) == 0) {
-      result->emplace_back(array_[i].second);
-      flag = true;
-    } else if (!IsOccupied(i)) {  // 提前结束寻找
+  uint8_t fingerprint = Fingerprint(hash);
+  for (uint32_t group_start = 0; group_start < SLOT_COUNT; group_start += FINGERPRINT_GROUP_SIZE) {
+    uint32_t matches = MatchGroup(group_start, fingerprint);
+    while (matches != 0) {  // 只对指纹相同的槽调用比较器
+      uint32_t i = group_start + __builtin_ctz(matches);
+      matches &= matches - 1;
+      if (cmp(array_[i].first, key) == 0) {
+        result->emplace_back(array_[i].second);
+        flag = true;
+      }
+    }
+    if (LoadGroupBits(occupied_, group_start) != FULL_GROUP) {  // 组内有未占用的槽，之后的槽都未占用，提前结束
       break;
     }
   }
@@ -35,46 +73,167 @@ auto HASH_TABLE_BUCKET_TYPE::GetValue(KeyType key, KeyComparator cmp, std::vecto
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-auto HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator cmp) -> bool {
-  uint32_t array_size = BUCKET_ARRAY_SIZE;
-  uint32_t pos = array_size;  // 可以插入的位置
-  for (uint32_t i = 0; i < array_size; i++) {
-    if (IsReadable(i) && cmp(array_[i].first, key) == 0 && array_[i].second == value) {  // 是否存在相同的元素
-      return false;
-    }
-    if (!IsReadable(i)) {
-      if (pos == array_size) {  // 插入位置尚未设置
-        pos = i;
-      }
-      if (!IsOccupied(i)) {  // 提前结束寻找
-        break;
-      }
-    }
+auto HASH_TABLE_BUCKET_TYPE::Insert(KeyType key, ValueType value, KeyComparator cmp, uint32_t hash) -> bool {
+  if (!HasCurrentLayout()) {
+    return false;
   }
-  if (pos == array_size) {  // bucket已满
+  uint8_t fingerprint = Fingerprint(hash);
+  if (FindPair(key, value, fingerprint, cmp) != SLOT_COUNT) {  // 是否存在相同的元素
     return false;
   }
-  // 设置kv值，同时设置标志位
+  uint32_t pos = FindFreeSlot();  // 可以插入的位置
+  if (pos == SLOT_COUNT) {  // bucket已满
+    return false;
+  }
+  // 设置kv值和指纹，同时设置标志位；新页全为0，第一次插入时写入布局
+  layout_ = BUCKET_LAYOUT_FINGERPRINTS;
   array_[pos].first = key;
   array_[pos].second = value;
+  fingerprints_[pos] = fingerprint;
   SetOccupied(pos);
   SetReadable(pos);
   return true;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
-auto HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, KeyComparator cmp) -> bool {
-  uint32_t array_size = BUCKET_ARRAY_SIZE;
-  for (uint32_t i = 0; i < array_size; i++) {
-    if (IsReadable(i) && cmp(array_[i].first, key) == 0 && array_[i].second == value) {
-      SetUnreadable(i);  // 将可读位设置为无效
-      return true;
+auto HASH_TABLE_BUCKET_TYPE::Remove(KeyType key, ValueType value, KeyComparator cmp, uint32_t hash) -> bool {
+  uint32_t i = FindPair(key, value, Fingerprint(hash), cmp);
+  if (i == SLOT_COUNT) {
+    return false;
+  }
+  SetUnreadable(i);  // 将可读位设置为无效
+  uint32_t live = NumReadable();
+  uint32_t tombstones = NumOccupied() - live;
+  if (tombstones >= COMPACT_MIN_TOMBSTONES && tombstones > live) {  // 墓碑多于元素时压缩，探测长度与元素个数成正比
+    Compact();
+  }
+  return true;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::Contains(KeyType key, ValueType value, KeyComparator cmp, uint32_t hash) const -> bool {
+  return FindPair(key, value, Fingerprint(hash), cmp) != SLOT_COUNT;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::FindPair(const KeyType &key, const ValueType &value, uint8_t fingerprint,
+                                      KeyComparator cmp) const -> uint32_t {
+  if (!HasCurrentLayout()) {
+    return SLOT_COUNT;
+  }
+  for (uint32_t group_start = 0; group_start < SLOT_COUNT; group_start += FINGERPRINT_GROUP_SIZE) {
+    uint32_t matches = MatchGroup(group_start, fingerprint);
+    while (matches != 0) {
+      uint32_t i = group_start + __builtin_ctz(matches);
+      matches &= matches - 1;
+      if (cmp(array_[i].first, key) == 0 && array_[i].second == value) {
+        return i;
+      }
     }
-    if (!IsOccupied(i)) {  // 提前结束寻找
+    if (LoadGroupBits(occupied_, group_start) != FULL_GROUP) {  // 提前结束寻找
       break;
     }
   }
-  return false;
+  return SLOT_COUNT;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+void HASH_TABLE_BUCKET_TYPE::Compact() {
+  uint32_t live = NumReadable();
+  uint32_t tail = SLOT_COUNT;
+  // 依次把最后面的元素移到最前面的空槽，直到前live个槽都可读
+  for (uint32_t hole = FindFreeSlot(); hole < live; hole = FindFreeSlot()) {
+    do {
+      tail--;
+    } while (!IsReadable(tail));
+    array_[hole] = array_[tail];
+    fingerprints_[hole] = fingerprints_[tail];
+    SetReadable(hole);
+    SetUnreadable(tail);
+  }
+  std::memcpy(occupied_, readable_, BITMAP_SIZE);  // 可读的槽已是前缀，其余槽不再占用
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::KeyHash(const KeyType &key) -> uint32_t {
+  hash_t hash = HashUtil::HashBytes(reinterpret_cast<const char *>(&key), sizeof(KeyType));
+  // HashBytes的高位几乎不随短键变化，乘一个64位奇数常量把各位扩散到高32位，指纹取其最高字节
+  return static_cast<uint32_t>((static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::HasCurrentLayout() const -> bool {
+  return layout_ == BUCKET_LAYOUT_FINGERPRINTS || layout_ == 0;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::GroupMask(uint32_t group_start) -> uint32_t {
+  uint32_t rest = SLOT_COUNT - group_start;
+  return rest >= FINGERPRINT_GROUP_SIZE ? FULL_GROUP : (1U << rest) - 1;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::LoadGroupBits(const unsigned char *bitmap, uint32_t group_start) -> uint32_t {
+  static_assert(FINGERPRINT_GROUP_SIZE == 16, "a group spans two bitmap bytes");
+  uint32_t index = group_start / 8;
+  return bitmap[index] | (static_cast<uint32_t>(bitmap[index + 1]) << 8);
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::LoadWord(const unsigned char *bitmap, uint32_t word_idx) -> uint64_t {
+  uint64_t word = 0;
+  uint32_t offset = word_idx * 8;
+  // 位图的长度不一定是8的倍数，最后一个字只复制剩余的字节
+  std::memcpy(&word, bitmap + offset, std::min<uint32_t>(8, BITMAP_SIZE - offset));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64(word);  // 第i个字节存放第8i到8i+7个槽，需按小端序组成字
+#endif
+  return word;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::WordMask(uint32_t word_idx) -> uint64_t {
+  uint32_t rest = SLOT_COUNT - word_idx * 64;
+  return rest >= 64 ? ~static_cast<uint64_t>(0) : (static_cast<uint64_t>(1) << rest) - 1;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::NumOccupied() const -> uint32_t {
+  uint32_t cnt = 0;
+  for (uint32_t i = 0; i < BITMAP_WORDS; i++) {
+    cnt += __builtin_popcountll(LoadWord(occupied_, i) & WordMask(i));
+  }
+  return cnt;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::FindFreeSlot() const -> uint32_t {
+  for (uint32_t i = 0; i < BITMAP_WORDS; i++) {
+    uint64_t free = ~LoadWord(readable_, i) & WordMask(i);
+    if (free != 0) {
+      return i * 64 + __builtin_ctzll(free);
+    }
+  }
+  return SLOT_COUNT;
+}
+
+template <typename KeyType, typename ValueType, typename KeyComparator>
+auto HASH_TABLE_BUCKET_TYPE::MatchGroup(uint32_t group_start, uint8_t fingerprint) const -> uint32_t {
+#if defined(__SSE2__)
+  // 一条指令比较整组16个指纹，fingerprints_补齐到整组，读取不会越界
+  __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(fingerprints_ + group_start));
+  __m128i equal = _mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(fingerprint)));
+  auto matches = static_cast<uint32_t>(_mm_movemask_epi8(equal));
+#else
+  uint32_t matches = 0;
+  for (uint32_t i = 0; i < FINGERPRINT_GROUP_SIZE; i++) {
+    if (fingerprints_[group_start + i] == fingerprint) {
+      matches |= 1U << i;
+    }
+  }
+#endif
+  // 删除或未使用的槽的指纹无效，最后一组中SLOT_COUNT之后的补齐部分不是槽
+  return matches & LoadGroupBits(readable_, group_start) & GroupMask(group_start);
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
@@ -135,43 +294,38 @@ void HASH_TABLE_BUCKET_TYPE::SetUnreadable(uint32_t bucket_idx) {
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_BUCKET_TYPE::IsFull() -> bool {
-  uint32_t exact_div_size = BUCKET_ARRAY_SIZE / 8;  // 整除的部分应该全部为ff
-  for (uint32_t i = 0; i < exact_div_size; i++) {
-    // readable_[i]类型为unsigned char，故可以直接与0xff比较
-    if (readable_[i] != 0xff) {
+  if (!HasCurrentLayout()) {
+    return true;  // 旧布局的页不能再插入
+  }
+  for (uint32_t i = 0; i < BITMAP_WORDS; i++) {
+    if (LoadWord(readable_, i) != WordMask(i)) {  // 最后一个字只有对应槽的位为1
       return false;
     }
   }
-  uint32_t rest = BUCKET_ARRAY_SIZE - BUCKET_ARRAY_SIZE / 8 * 8;  // 只有rest个位为1
-  unsigned char expect_value = (1 << rest) - 1;
-  return !(rest != 0 && readable_[(BUCKET_ARRAY_SIZE - 1) / 8] != expect_value);
+  return true;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_BUCKET_TYPE::NumReadable() -> uint32_t {
   uint32_t cnt = 0;
-  uint32_t array_size = (BUCKET_ARRAY_SIZE - 1) / 8 + 1;
-  unsigned char n;
-  for (uint32_t i = 0; i < array_size; i++) {
-    n = readable_[i];
-    while (n != 0) {
-      n &= n - 1;  // 将最低位1清0, 计算1的个数
-      cnt++;
-    }
+  for (uint32_t i = 0; i < BITMAP_WORDS; i++) {
+    cnt += __builtin_popcountll(LoadWord(readable_, i) & WordMask(i));
   }
   return cnt;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_BUCKET_TYPE::Size() -> uint32_t {  // 返回桶的大小
-  return BUCKET_ARRAY_SIZE;
+  return SLOT_COUNT;
 }
 
 template <typename KeyType, typename ValueType, typename KeyComparator>
 auto HASH_TABLE_BUCKET_TYPE::IsEmpty() -> bool {
-  uint32_t array_size = (BUCKET_ARRAY_SIZE - 1) / 8 + 1;
-  for (uint32_t i = 0; i < array_size; i++) {
-    if (readable_[i] != 0) {
+  if (!HasCurrentLayout()) {
+    return false;  // 不能当作空桶合并掉
+  }
+  for (uint32_t i = 0; i < BITMAP_WORDS; i++) {
+    if (LoadWord(readable_, i) != 0) {
       return false;
     }
   }
@@ -183,7 +337,7 @@ void HASH_TABLE_BUCKET_TYPE::PrintBucket() {
   uint32_t size = 0;
   uint32_t taken = 0;
   uint32_t free = 0;
-  for (size_t bucket_idx = 0; bucket_idx < BUCKET_ARRAY_SIZE; bucket_idx++) {
+  for (size_t bucket_idx = 0; bucket_idx < SLOT_COUNT; bucket_idx++) {
     if (!IsOccupied(bucket_idx)) {
       break;
     }
@@ -197,7 +351,7 @@ void HASH_TABLE_BUCKET_TYPE::PrintBucket() {
     }
   }
 
-  LOG_INFO("Bucket Capacity: %lu, Size: %u, Taken: %u, Free: %u", BUCKET_ARRAY_SIZE, size, taken, free);
+  LOG_INFO("Bucket Capacity: %u, Size: %u, Taken: %u, Free: %u", SLOT_COUNT, size, taken, free);
 }
 
 // DO NOT REMOVE ANYTHING BELOW THIS LINE
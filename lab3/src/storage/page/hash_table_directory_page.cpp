@@ -77,6 +77,18 @@ void HashTableDirectoryPage::DecrLocalDepth(uint32_t bucket_idx) { local_depths_
 
 auto HashTableDirectoryPage::GetLocalHighBit(uint32_t bucket_idx) -> uint32_t { return 0; }
 
+auto HashTableDirectoryPage::GetNumSegmentPages() -> uint32_t { return num_segment_pages_; }
+
+void HashTableDirectoryPage::SetNumSegmentPages(uint32_t num_segment_pages) { num_segment_pages_ = num_segment_pages; }
+
+auto HashTableDirectoryPage::GetSegmentPageId(uint32_t segment_idx) -> page_id_t {
+  return segment_page_ids_[segment_idx - 1];
+}
+
+void HashTableDirectoryPage::SetSegmentPageId(uint32_t segment_idx, page_id_t segment_page_id) {
+  segment_page_ids_[segment_idx - 1] = segment_page_id;
+}
+
 /**
  * VerifyIntegrity - Use this for debugging but **DO NOT CHANGE**
  *
@@ -132,7 +144,9 @@ void HashTableDirectoryPage::VerifyIntegrity() {
 void HashTableDirectoryPage::PrintDirectory() {
   LOG_DEBUG("======== DIRECTORY (global_depth_: %u) ========", global_depth_);
   LOG_DEBUG("| bucket_idx | page_id | local_depth |");
-  for (uint32_t idx = 0; idx < static_cast<uint32_t>(0x1 << global_depth_); idx++) {
+  // 多页目录只打印本页的一段
+  uint32_t size = std::min<uint32_t>(0x1 << global_depth_, DIRECTORY_ARRAY_SIZE);
+  for (uint32_t idx = 0; idx < size; idx++) {
     LOG_DEBUG("|      %u     |     %u     |     %u     |", idx, bucket_page_ids_[idx], local_depths_[idx]);
   }
   LOG_DEBUG("================ END DIRECTORY ================");
@@ -0,0 +1,152 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_guard.cpp
+//
+// Identification: src/storage/page/page_guard.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/page/page_guard.h"
+
+namespace bustub {
+
+BasicPageGuard::BasicPageGuard(BasicPageGuard &&that) noexcept
+    : bpm_(that.bpm_), page_(that.page_), swizzler_(that.swizzler_), is_dirty_(that.is_dirty_) {
+  that.page_ = nullptr;
+}
+
+auto BasicPageGuard::operator=(BasicPageGuard &&that) noexcept -> BasicPageGuard & {
+  if (this != &that) {
+    Drop();  // 先放回自己原来持有的页
+    bpm_ = that.bpm_;
+    page_ = that.page_;
+    swizzler_ = that.swizzler_;
+    is_dirty_ = that.is_dirty_;
+    that.page_ = nullptr;
+  }
+  return *this;
+}
+
+void BasicPageGuard::Drop() {
+  if (page_ == nullptr) {
+    return;
+  }
+  if (swizzler_ != nullptr) {
+    swizzler_->UnpinSwizzled(page_, is_dirty_);
+  } else {
+    bpm_->UnpinPage(page_->GetPageId(), is_dirty_, nullptr);
+  }
+  page_ = nullptr;
+  is_dirty_ = false;
+}
+
+auto BasicPageGuard::UpgradeRead() -> ReadPageGuard {
+  if (page_ != nullptr) {
+    page_->RLatch();
+  }
+  return ReadPageGuard(std::move(*this));
+}
+
+auto BasicPageGuard::UpgradeWrite() -> WritePageGuard {
+  if (page_ != nullptr) {
+    page_->WLatch();
+  }
+  return WritePageGuard(std::move(*this));
+}
+
+auto ReadPageGuard::operator=(ReadPageGuard &&that) noexcept -> ReadPageGuard & {
+  if (this != &that) {
+    Drop();  // 先释放自己原来持有的读锁
+    guard_ = std::move(that.guard_);
+  }
+  return *this;
+}
+
+void ReadPageGuard::Drop() {
+  if (guard_.page_ == nullptr) {
+    return;
+  }
+  guard_.page_->RUnlatch();
+  guard_.Drop();
+}
+
+WritePageGuard::WritePageGuard(WritePageGuard &&that) noexcept
+    : guard_(std::move(that.guard_)), modified_(that.modified_), writing_(that.writing_) {
+  that.modified_ = false;
+  that.writing_ = nullptr;
+}
+
+auto WritePageGuard::operator=(WritePageGuard &&that) noexcept -> WritePageGuard & {
+  if (this != &that) {
+    Drop();  // 先释放自己原来持有的写锁
+    guard_ = std::move(that.guard_);
+    modified_ = that.modified_;
+    writing_ = that.writing_;
+    that.modified_ = false;
+    that.writing_ = nullptr;
+  }
+  return *this;
+}
+
+void WritePageGuard::Drop() {
+  if (guard_.page_ == nullptr) {
+    return;
+  }
+  // 乐观读者要在写锁释放前看到修改已结束
+  if (writing_ != nullptr) {
+    writing_->EndPageWrite(guard_.page_);
+    writing_ = nullptr;
+  }
+  modified_ = false;
+  guard_.page_->WUnlatch();
+  guard_.Drop();
+}
+
+auto WritePageGuard::GetDataMut() -> char * {
+  if (!modified_) {
+    // 第一次修改前使该页的乐观读失败，只读访问的写锁不影响乐观读者
+    modified_ = true;
+    writing_ = OptimisticPageReader::FromBufferPool(guard_.bpm_);
+    if (writing_ != nullptr) {
+      writing_->BeginPageWrite(guard_.page_);
+    }
+  }
+  return guard_.GetDataMut();
+}
+
+auto FetchPageBasic(BufferPoolManager *bpm, page_id_t page_id) -> BasicPageGuard {
+  return BasicPageGuard(bpm, bpm->FetchPage(page_id, nullptr));
+}
+
+auto FetchPageRead(BufferPoolManager *bpm, page_id_t page_id) -> ReadPageGuard {
+  return FetchPageBasic(bpm, page_id).UpgradeRead();
+}
+
+auto FetchPageWrite(BufferPoolManager *bpm, page_id_t page_id) -> WritePageGuard {
+  return FetchPageBasic(bpm, page_id).UpgradeWrite();
+}
+
+auto NewPageGuarded(BufferPoolManager *bpm, page_id_t *page_id) -> BasicPageGuard {
+  return BasicPageGuard(bpm, bpm->NewPage(page_id, nullptr));
+}
+
+auto PinPageThroughRef(BufferPoolManager *bpm, PageSwizzler *swizzler, std::atomic<Page *> *ref, page_id_t page_id)
+    -> BasicPageGuard {
+  // 引用仍指向该页时直接pin页框，不查缓冲池的页表
+  Page *page = ref->load(std::memory_order_relaxed);
+  if (swizzler != nullptr && page != nullptr && swizzler->PinSwizzled(page, page_id)) {
+    return BasicPageGuard(bpm, page, swizzler);
+  }
+  // 页被换出、删除或引用已指向其他页，引用失效，重新fetch后更新引用
+  page = bpm->FetchPage(page_id, nullptr);
+  if (swizzler != nullptr) {
+    ref->store(page, std::memory_order_relaxed);
+  }
+  return BasicPageGuard(bpm, page);
+}
+
+}  // namespace bustub
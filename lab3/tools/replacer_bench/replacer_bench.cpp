@@ -0,0 +1,130 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// replacer_bench.cpp
+//
+// Identification: tools/replacer_bench/replacer_bench.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/clock_replacer.h"
+#include "buffer/lru_replacer.h"
+#include "buffer/partitioned_lru_replacer.h"
+
+/**
+ * Micro-benchmark of the replacers under concurrent Pin/Unpin, as done by the hit path of the buffer pool.
+ *
+ * Every thread repeatedly pins and unpins random frames of its own slice of the pool, and calls Victim once every
+ * VICTIM_INTERVAL operations to model a miss. Usage: replacer_bench [threads] [frames] [seconds]
+ *
+ * Without a thread count, every replacer is run with 1, 2, 4, ... up to MAX_SWEEP_THREADS threads, which shows how
+ * its throughput scales; the sweep only means something on a machine with at least that many cores.
+ */
+namespace {
+
+using bustub::frame_id_t;
+using bustub::Replacer;
+
+constexpr size_t VICTIM_INTERVAL = 64;
+constexpr size_t MAX_SWEEP_THREADS = 64;
+
+struct BenchResult {
+  uint64_t operations_;
+  double seconds_;
+};
+
+auto RunBench(Replacer *replacer, size_t num_threads, size_t num_frames, double seconds) -> BenchResult {
+  // 开始前所有页框都可淘汰
+  for (size_t i = 0; i < num_frames; i++) {
+    replacer->Unpin(static_cast<frame_id_t>(i));
+  }
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> operations{0};
+  std::vector<std::thread> threads;
+  size_t slice = num_frames / num_threads;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t t = 0; t < num_threads; t++) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      std::uniform_int_distribution<size_t> dist(0, slice - 1);
+      uint64_t local = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto frame_id = static_cast<frame_id_t>(t * slice + dist(rng));
+        replacer->Pin(frame_id);
+        replacer->Unpin(frame_id);
+        if (++local % VICTIM_INTERVAL == 0) {
+          frame_id_t victim;
+          if (replacer->Victim(&victim)) {
+            replacer->Unpin(victim);
+          }
+        }
+      }
+      operations.fetch_add(local, std::memory_order_relaxed);
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+  stop = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return {operations.load(), elapsed.count()};
+}
+
+}  // namespace
+
+auto main(int argc, char **argv) -> int {
+  size_t num_threads = argc > 1 ? std::stoul(argv[1]) : 0;
+  size_t num_frames = argc > 2 ? std::stoul(argv[2]) : 4096;
+  double seconds = argc > 3 ? std::stod(argv[3]) : 2;
+  // 未指定线程数时从1到MAX_SWEEP_THREADS逐次翻倍
+  std::vector<size_t> thread_counts;
+  if (argc > 1) {
+    thread_counts.push_back(num_threads);
+  } else {
+    for (size_t n = 1; n <= MAX_SWEEP_THREADS; n *= 2) {
+      thread_counts.push_back(n);
+    }
+  }
+  if (thread_counts.front() == 0 || num_frames < thread_counts.back()) {
+    fprintf(stderr, "usage: %s [threads] [frames >= threads] [seconds]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<std::pair<std::string, std::function<std::unique_ptr<Replacer>()>>> replacers = {
+      {"lru", [&] { return std::make_unique<bustub::LRUReplacer>(num_frames); }},
+      {"clock", [&] { return std::make_unique<bustub::ClockReplacer>(num_frames); }},
+      {"plru", [&] { return std::make_unique<bustub::PartitionedLRUReplacer>(num_frames); }},
+  };
+  printf("frames=%zu seconds=%.1f cores=%u\n", num_frames, seconds, std::thread::hardware_concurrency());
+  printf("%-8s", "threads");
+  for (const auto &replacer : replacers) {
+    printf("%12s", replacer.first.c_str());
+  }
+  printf("   (Mops/s)\n");
+  for (size_t threads : thread_counts) {
+    printf("%-8zu", threads);
+    for (const auto &[name, create] : replacers) {
+      auto replacer = create();
+      BenchResult result = RunBench(replacer.get(), threads, num_frames, seconds);
+      // 一次操作是一对Pin/Unpin
+      printf("%12.2f", static_cast<double>(result.operations_) / result.seconds_ / 1e6);
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+  return 0;
+}